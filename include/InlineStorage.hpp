@@ -0,0 +1,309 @@
+// Nitzanwa@gmail.com
+
+#ifndef INLINESTORAGE_HPP
+#define INLINESTORAGE_HPP
+
+#include "MyContainer.hpp"
+#include <memory>
+#include <algorithm>
+#include <initializer_list>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace ex4 {
+
+    /**
+     * InlineStorage - vector-like storage that keeps up to N elements inside the object
+     *
+     * Small containers never touch the allocator. Growing past N moves the elements to a heap block
+     * obtained from Allocator, and shrink_to_fit() moves them back once they fit again.
+     * Used as the Storage parameter of MyContainer (see SmallContainer below).
+     */
+    template<typename T, size_t N, typename Allocator = std::allocator<T>> class InlineStorage {
+        static_assert(N > 0, "InlineStorage needs an inline capacity of at least one element");
+
+    public:
+        using value_type = T;
+        using allocator_type = Allocator;
+        using size_type = size_t;
+        using reference = T&;
+        using const_reference = const T&;
+        using iterator = T*;
+        using const_iterator = const T*;
+
+    private:
+        using AllocatorTraits = std::allocator_traits<Allocator>;
+
+        [[no_unique_address]] Allocator allocator;
+        T* heap = nullptr;        // Heap block, null while the elements are stored inline
+        size_t count = 0;
+        size_t heap_capacity = 0;
+        alignas(T) unsigned char buffer[N * sizeof(T)];
+
+        T* inline_data() { return std::launder(reinterpret_cast<T*>(buffer)); }
+        const T* inline_data() const { return std::launder(reinterpret_cast<const T*>(buffer)); }
+
+        /**
+         * Move all elements to a block of new_capacity elements (inline if it fits)
+         * Strong guarantee: the old elements are only destroyed once every one has been moved (or,
+         * for a throwing move constructor, copied), so a failure leaves the storage unchanged
+         */
+        void relocate(size_t new_capacity) {
+            T* target = new_capacity <= N ? inline_data() : AllocatorTraits::allocate(allocator, new_capacity);
+            T* source = data();
+            if (target == source) return;
+
+            size_t built = 0;
+            try {
+                for (; built < count; ++built) {
+                    AllocatorTraits::construct(allocator, target + built, std::move_if_noexcept(source[built]));
+                }
+            } catch (...) {
+                for (size_t i = 0; i < built; ++i) {
+                    AllocatorTraits::destroy(allocator, target + i);
+                }
+                if (new_capacity > N) {
+                    AllocatorTraits::deallocate(allocator, target, new_capacity);
+                }
+                throw;
+            }
+            for (size_t i = 0; i < count; ++i) {
+                AllocatorTraits::destroy(allocator, source + i);
+            }
+            release_heap();
+            if (new_capacity > N) {
+                heap = target;
+                heap_capacity = new_capacity;
+            }
+        }
+
+        void release_heap() {
+            if (heap) {
+                AllocatorTraits::deallocate(allocator, heap, heap_capacity);
+                heap = nullptr;
+                heap_capacity = 0;
+            }
+        }
+
+        void grow_for(size_t needed) {
+            if (needed > capacity()) {
+                relocate(std::max(needed, capacity() * 2));
+            }
+        }
+
+        /**
+         * Take over other's elements - steals the heap block when allowed, moves element-wise otherwise
+         */
+        void take_from(InlineStorage& other) {
+            if (other.heap && allocator == other.allocator) {
+                heap = other.heap;
+                heap_capacity = other.heap_capacity;
+                count = other.count;
+                other.heap = nullptr;
+                other.heap_capacity = 0;
+                other.count = 0;
+                return;
+            }
+            reserve(other.count);
+            for (size_t i = 0; i < other.count; ++i) {
+                AllocatorTraits::construct(allocator, data() + i, std::move(other.data()[i]));
+            }
+            count = other.count;
+            other.clear();
+        }
+
+    public:
+        // ================== CONSTRUCTORS & DESTRUCTOR ==================
+
+        InlineStorage() = default;
+
+        explicit InlineStorage(const Allocator& alloc) : allocator(alloc) {}
+
+        // The filling constructors delegate to the allocator one, so the destructor releases the heap
+        // block when an element constructor throws part way through
+
+        InlineStorage(size_t n, const T& value, const Allocator& alloc = Allocator()) : InlineStorage(alloc) {
+            resize(n, value);
+        }
+
+        InlineStorage(size_t n, const Allocator& alloc) : InlineStorage(alloc) {
+            resize(n);
+        }
+
+        InlineStorage(std::initializer_list<T> values, const Allocator& alloc = Allocator())
+            : InlineStorage(values.begin(), values.end(), alloc) {}
+
+        template<std::input_iterator InputIt>
+        InlineStorage(InputIt first, InputIt last, const Allocator& alloc = Allocator()) : InlineStorage(alloc) {
+            if constexpr (std::forward_iterator<InputIt>) {
+                reserve(static_cast<size_t>(std::distance(first, last)));
+            }
+            for (; first != last; ++first) {
+                emplace_back(*first);
+            }
+        }
+
+        InlineStorage(const InlineStorage& other)
+            : InlineStorage(other, AllocatorTraits::select_on_container_copy_construction(other.allocator)) {}
+
+        InlineStorage(const InlineStorage& other, const Allocator& alloc)
+            : InlineStorage(other.begin(), other.end(), alloc) {}
+
+        InlineStorage(InlineStorage&& other) noexcept(std::is_nothrow_move_constructible_v<T>)
+            : InlineStorage(other.allocator) {
+            take_from(other);
+        }
+
+        /**
+         * Copy assignment - copies into a temporary first, so a throwing copy leaves this storage
+         * unchanged (strong guarantee as long as T's move constructor does not throw)
+         */
+        InlineStorage& operator=(const InlineStorage& other) {
+            if (this != &other) {
+                InlineStorage copy(other, allocator);
+                *this = std::move(copy);
+            }
+            return *this;
+        }
+
+        /**
+         * Move assignment - only noexcept when it never allocates, i.e. when the heap block can
+         * always be taken over because the allocators propagate or always compare equal
+         */
+        InlineStorage& operator=(InlineStorage&& other) 
+            noexcept(std::is_nothrow_move_constructible_v<T> 
+                     && (AllocatorTraits::propagate_on_container_move_assignment::value || AllocatorTraits::is_always_equal::value)) {
+            if (this != &other) {
+                clear();
+                release_heap();
+                if constexpr (AllocatorTraits::propagate_on_container_move_assignment::value) {
+                    allocator = other.allocator;
+                }
+                take_from(other);
+            }
+            return *this;
+        }
+
+        ~InlineStorage() {
+            clear();
+            release_heap();
+        }
+
+        // ================== ACCESS ==================
+
+        T* data() { return heap ? heap : inline_data(); }
+        const T* data() const { return heap ? heap : inline_data(); }
+
+        T& operator[](size_t index) { return data()[index]; }
+        const T& operator[](size_t index) const { return data()[index]; }
+
+        iterator begin() { return data(); }
+        iterator end() { return data() + count; }
+        const_iterator begin() const { return data(); }
+        const_iterator end() const { return data() + count; }
+
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        size_t capacity() const { return heap ? heap_capacity : N; }
+
+        /**
+         * Check whether the elements currently live inside the object
+         * @return true while no heap block is in use
+         */
+        bool is_inline() const { return heap == nullptr; }
+
+        /**
+         * Get the heap bytes held - zero while the elements are inline
+         */
+        size_t memory_bytes() const { return heap_capacity * sizeof(T); }
+
+        Allocator get_allocator() const { return allocator; }
+
+        // ================== MODIFIERS ==================
+
+        template<typename... Args> T& emplace_back(Args&&... args) {
+            if (count == capacity()) {
+                // Build the value first - args may refer to an element that is about to move
+                T value(std::forward<Args>(args)...);
+                grow_for(count + 1);
+                AllocatorTraits::construct(allocator, data() + count, std::move(value));
+            } else {
+                AllocatorTraits::construct(allocator, data() + count, std::forward<Args>(args)...);
+            }
+            return data()[count++];
+        }
+
+        void push_back(const T& value) { emplace_back(value); }
+        void push_back(T&& value) { emplace_back(std::move(value)); }
+
+        /**
+         * Erase [first, last), shifting the tail down
+         * @return Iterator to the element that followed the erased range
+         */
+        iterator erase(const_iterator first, const_iterator last) {
+            T* target = data() + (first - data());
+            T* tail = data() + (last - data());
+            T* new_end = std::move(tail, end(), target);
+            for (T* p = new_end; p != end(); ++p) {
+                AllocatorTraits::destroy(allocator, p);
+            }
+            count = static_cast<size_t>(new_end - data());
+            return target;
+        }
+
+        void resize(size_t n) {
+            grow_for(n);
+            while (count < n) emplace_back();
+            while (count > n) AllocatorTraits::destroy(allocator, data() + --count);
+        }
+
+        void resize(size_t n, const T& value) {
+            grow_for(n);
+            while (count < n) emplace_back(value);
+            while (count > n) AllocatorTraits::destroy(allocator, data() + --count);
+        }
+
+        void reserve(size_t n) {
+            if (n > capacity()) {
+                relocate(n);
+            }
+        }
+
+        /**
+         * Release unused heap capacity, moving the elements back inline when they fit
+         */
+        void shrink_to_fit() {
+            if (heap && heap_capacity > count) {
+                relocate(count);
+            }
+        }
+
+        void clear() {
+            for (size_t i = 0; i < count; ++i) {
+                AllocatorTraits::destroy(allocator, data() + i);
+            }
+            count = 0;
+        }
+    };
+
+    namespace detail {
+
+        // Keep the sorted index of an inline container inline as well
+        template<typename T, size_t N, typename A, typename U, typename Allocator>
+        struct rebind_storage<InlineStorage<T, N, A>, U, Allocator> {
+            using type = InlineStorage<U, N, typename std::allocator_traits<Allocator>::template rebind_alloc<U>>;
+        };
+
+    } // End of detail namespace
+
+    /**
+     * MyContainer that stores up to N elements (and their sorted index) without heap allocation
+     */
+    template<typename T, size_t N, typename Allocator = std::allocator<T>>
+    using SmallContainer = MyContainer<T, Allocator, InlineStorage<T, N, Allocator>>;
+
+} // End of ex4 namespace
+
+#endif // INLINESTORAGE_HPP
@@ -0,0 +1,361 @@
+// Nitzanwa@gmail.com
+
+#ifndef MAPPEDSTORAGE_HPP
+#define MAPPEDSTORAGE_HPP
+
+#include "MyContainer.hpp"
+#include <memory>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ex4 {
+
+    /**
+     * MappedStorage - vector-like storage kept in a memory-mapped file (POSIX mmap)
+     *
+     * The file holds a small header (format tag, element size, element count) followed by the raw
+     * elements. Opening a file maps it without reading anything, so startup time does not depend on
+     * the data size and the OS page cache decides what stays resident; iterators run directly over
+     * the mapped pages. Appends write straight into the mapping and the file grows geometrically.
+     * A default-constructed (or copied) storage uses an anonymous mapping instead of a file.
+     * Used as the Storage parameter of MyContainer (see MappedContainer below).
+     *
+     * Template parameter T must be trivially copyable - elements are stored as raw bytes
+     */
+    template<typename T> class MappedStorage {
+        static_assert(std::is_trivially_copyable_v<T>, "MappedStorage stores raw bytes and needs a trivially copyable T");
+
+        struct Header {
+            std::uint64_t magic;
+            std::uint64_t element_size;
+            std::uint64_t count;
+        };
+
+        static constexpr size_t header_bytes = 64;  // Elements start on a cache-line boundary
+        static constexpr std::uint64_t file_magic = 0x3445584D41505031ULL;
+
+        static_assert(alignof(T) <= header_bytes, "MappedStorage cannot align T");
+
+    public:
+        using value_type = T;
+        using allocator_type = std::allocator<T>;
+        using size_type = size_t;
+        using reference = T&;
+        using const_reference = const T&;
+        using iterator = T*;
+        using const_iterator = const T*;
+
+    private:
+        int fd = -1;                     // Backing file, -1 for an anonymous mapping
+        std::byte* mapping = nullptr;    // Header followed by the elements, null until first use
+        size_t mapped_bytes = 0;
+        size_t count = 0;
+
+        [[noreturn]] static void throw_errno(const char* what) {
+            throw std::system_error(errno, std::generic_category(), what);
+        }
+
+        Header* header() const { return reinterpret_cast<Header*>(mapping); }
+
+        void set_count(size_t n) {
+            count = n;
+            if (mapping) {
+                header()->count = n;
+            }
+        }
+
+        /**
+         * Map a region of header_bytes + new_capacity elements, keeping the current elements
+         * File-backed storage resizes the file; anonymous storage copies into a fresh mapping
+         * @throws std::system_error if the file cannot be resized or mapped
+         */
+        void remap(size_t new_capacity) {
+            size_t new_bytes = header_bytes + new_capacity * sizeof(T);
+            void* target;
+
+            if (fd >= 0) {
+                if (new_bytes > mapped_bytes && ::ftruncate(fd, static_cast<off_t>(new_bytes)) != 0) {
+                    throw_errno("ftruncate");
+                }
+                target = ::mmap(nullptr, new_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if (target == MAP_FAILED) {
+                    throw_errno("mmap");
+                }
+                // Shrink while the old mapping is still held, so a failure leaves it in place
+                if (new_bytes < mapped_bytes && ::ftruncate(fd, static_cast<off_t>(new_bytes)) != 0) {
+                    ::munmap(target, new_bytes);
+                    throw_errno("ftruncate");
+                }
+                if (mapping) {
+                    ::munmap(mapping, mapped_bytes);
+                }
+            } else {
+                target = ::mmap(nullptr, new_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (target == MAP_FAILED) {
+                    throw_errno("mmap");
+                }
+                if (mapping) {
+                    std::memcpy(target, mapping, header_bytes + count * sizeof(T));
+                    ::munmap(mapping, mapped_bytes);
+                }
+            }
+
+            mapping = static_cast<std::byte*>(target);
+            mapped_bytes = new_bytes;
+            *header() = Header{file_magic, sizeof(T), count};
+        }
+
+        void release() {
+            if (mapping) {
+                ::munmap(mapping, mapped_bytes);
+                mapping = nullptr;
+                mapped_bytes = 0;
+            }
+            if (fd >= 0) {
+                ::close(fd);
+                fd = -1;
+            }
+            count = 0;
+        }
+
+        void steal(MappedStorage& other) {
+            fd = std::exchange(other.fd, -1);
+            mapping = std::exchange(other.mapping, nullptr);
+            mapped_bytes = std::exchange(other.mapped_bytes, 0);
+            count = std::exchange(other.count, 0);
+        }
+
+    public:
+        // ================== CONSTRUCTORS & DESTRUCTOR ==================
+
+        MappedStorage() = default;
+
+        explicit MappedStorage(const allocator_type&) {}
+
+        /**
+         * Open (or create) a file-backed storage
+         * An existing file is mapped as is - its elements are available immediately
+         * @param path The file to map
+         * @throws std::system_error if the file cannot be opened or mapped
+         * @throws std::runtime_error if the file was not written by MappedStorage<T> of the same element size
+         */
+        explicit MappedStorage(const std::string& path) {
+            fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+            if (fd < 0) {
+                throw_errno("open");
+            }
+            struct stat info;
+            if (::fstat(fd, &info) != 0) {
+                int error = errno;
+                release();
+                throw std::system_error(error, std::generic_category(), "fstat");
+            }
+
+            size_t file_bytes = static_cast<size_t>(info.st_size);
+            if (file_bytes == 0) {
+                remap(0);
+                return;
+            }
+
+            void* target = MAP_FAILED;
+            if (file_bytes >= header_bytes) {
+                target = ::mmap(nullptr, file_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            }
+            if (target != MAP_FAILED) {
+                mapping = static_cast<std::byte*>(target);
+                mapped_bytes = file_bytes;
+            }
+            if (!mapping || header()->magic != file_magic || header()->element_size != sizeof(T)
+                || header()->count > capacity()) {
+                release();
+                throw std::runtime_error("File is not a MappedStorage of this element type: " + path);
+            }
+            count = static_cast<size_t>(header()->count);
+        }
+
+        MappedStorage(size_t n, const T& value, const allocator_type& = allocator_type()) {
+            resize(n, value);
+        }
+
+        MappedStorage(size_t n, const allocator_type&) {
+            resize(n);
+        }
+
+        MappedStorage(std::initializer_list<T> values, const allocator_type& alloc = allocator_type())
+            : MappedStorage(values.begin(), values.end(), alloc) {}
+
+        template<std::input_iterator InputIt>
+        MappedStorage(InputIt first, InputIt last, const allocator_type& = allocator_type()) {
+            if constexpr (std::forward_iterator<InputIt>) {
+                reserve(static_cast<size_t>(std::distance(first, last)));
+            }
+            for (; first != last; ++first) {
+                emplace_back(*first);
+            }
+        }
+
+        /**
+         * Copy constructor - the copy lives in anonymous memory, never in other's file
+         */
+        MappedStorage(const MappedStorage& other) : MappedStorage(other.begin(), other.end()) {}
+
+        MappedStorage(const MappedStorage& other, const allocator_type&) : MappedStorage(other) {}
+
+        MappedStorage(MappedStorage&& other) noexcept {
+            steal(other);
+        }
+
+        /**
+         * Copy assignment - replaces the elements, keeping this storage's backing (file or anonymous)
+         */
+        MappedStorage& operator=(const MappedStorage& other) {
+            if (this != &other) {
+                clear();
+                reserve(other.count);
+                if (other.count > 0) {
+                    std::memcpy(static_cast<void*>(data()), other.data(), other.count * sizeof(T));
+                }
+                set_count(other.count);
+            }
+            return *this;
+        }
+
+        MappedStorage& operator=(MappedStorage&& other) noexcept {
+            if (this != &other) {
+                release();
+                steal(other);
+            }
+            return *this;
+        }
+
+        ~MappedStorage() {
+            release();
+        }
+
+        // ================== ACCESS ==================
+
+        T* data() { return mapping ? reinterpret_cast<T*>(mapping + header_bytes) : nullptr; }
+        const T* data() const { return mapping ? reinterpret_cast<const T*>(mapping + header_bytes) : nullptr; }
+
+        T& operator[](size_t index) { return data()[index]; }
+        const T& operator[](size_t index) const { return data()[index]; }
+
+        iterator begin() { return data(); }
+        iterator end() { return data() + count; }
+        const_iterator begin() const { return data(); }
+        const_iterator end() const { return data() + count; }
+
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        size_t capacity() const { return mapping ? (mapped_bytes - header_bytes) / sizeof(T) : 0; }
+
+        /**
+         * Check whether the elements are backed by a file
+         * @return false for anonymous (default-constructed or copied) storage
+         */
+        bool is_file_backed() const { return fd >= 0; }
+
+        /**
+         * Get the size of the mapping (header included) - pages the OS may page in, not heap
+         */
+        size_t memory_bytes() const { return mapped_bytes; }
+
+        // The sorted index of a MappedContainer lives on the regular heap
+        allocator_type get_allocator() const { return {}; }
+
+        /**
+         * Write dirty pages back to the file and wait for completion
+         * @throws std::system_error if msync fails
+         */
+        void flush() const {
+            if (fd >= 0 && mapping && ::msync(mapping, mapped_bytes, MS_SYNC) != 0) {
+                throw_errno("msync");
+            }
+        }
+
+        // ================== MODIFIERS ==================
+
+        template<typename... Args> T& emplace_back(Args&&... args) {
+            if (count == capacity()) {
+                // Build the value first - args may refer to an element of the old mapping
+                T value(std::forward<Args>(args)...);
+                reserve(std::max<size_t>(count * 2, 4096 / sizeof(T) + 1));
+                std::memcpy(static_cast<void*>(data() + count), &value, sizeof(T));
+            } else {
+                std::construct_at(data() + count, std::forward<Args>(args)...);
+            }
+            set_count(count + 1);
+            return data()[count - 1];
+        }
+
+        void push_back(const T& value) { emplace_back(value); }
+
+        /**
+         * Erase [first, last), shifting the tail down
+         * @return Iterator to the element that followed the erased range
+         */
+        iterator erase(const_iterator first, const_iterator last) {
+            T* target = data() + (first - data());
+            size_t tail = static_cast<size_t>(end() - last);
+            if (tail > 0) {
+                std::memmove(static_cast<void*>(target), last, tail * sizeof(T));
+            }
+            set_count(count - static_cast<size_t>(last - first));
+            return target;
+        }
+
+        void resize(size_t n) { resize(n, T()); }
+
+        void resize(size_t n, const T& value) {
+            reserve(n);
+            std::uninitialized_fill(data() + std::min(count, n), data() + n, value);
+            set_count(n);
+        }
+
+        void reserve(size_t n) {
+            if (n > capacity() || !mapping) {
+                remap(std::max(n, capacity()));
+            }
+        }
+
+        /**
+         * Shrink the mapping (and the file) to the current size
+         */
+        void shrink_to_fit() {
+            if (mapping && capacity() > count) {
+                remap(count);
+            }
+        }
+
+        void clear() { set_count(0); }
+    };
+
+    namespace detail {
+
+        // A reserve grows the file - keep it to what the range needs
+        template<typename T> struct geometric_reserve<MappedStorage<T>> : std::false_type {};
+
+    } // End of detail namespace
+
+    /**
+     * MyContainer over a memory-mapped file
+     * Usage: MappedContainer<int> container(MappedStorage<int>("values.bin"));
+     */
+    template<typename T> using MappedContainer = MyContainer<T, std::allocator<T>, MappedStorage<T>>;
+
+} // End of ex4 namespace
+
+#endif // MAPPEDSTORAGE_HPP
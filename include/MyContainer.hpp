@@ -6,92 +6,1391 @@
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <compare>
 #include <stdexcept>
 #include <iomanip>
+#include <bit>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <ranges>
+#include <cstddef>
+#include <initializer_list>
+#include <type_traits>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 
 namespace ex4 {
+
+    namespace detail {
+
+        /**
+         * Map a rank in side-cross order to a rank in ascending order
+         * Even ranks take from the front of the sorted order, odd ranks from the back
+         * Example (size 5): 0,1,2,3,4 -> 0,4,1,3,2
+         */
+        constexpr size_t side_cross_rank(size_t rank, size_t size) {
+            return (rank % 2 == 0) ? rank / 2 : size - 1 - rank / 2;
+        }
+
+        /**
+         * Map a rank in middle-out order to a position in insertion order
+         * Rank 0 is the middle, odd ranks step left and even ranks step right
+         * Example (size 5): 0,1,2,3,4 -> 2,1,3,0,4
+         */
+        constexpr size_t middle_out_position(size_t rank, size_t size) {
+            size_t middle = size / 2;
+            size_t distance = (rank + 1) / 2;
+            return (rank % 2 == 1) ? middle - distance : middle + distance;
+        }
+
+        /**
+         * Storage used for per-element bookkeeping (sorted positions, flags) of a container whose
+         * elements live in Storage. Defaults to std::vector with the rebound allocator; storages with
+         * inline capacity specialize it so the bookkeeping stays inline too.
+         */
+        template<typename Storage, typename U, typename Allocator> struct rebind_storage {
+            using type = std::vector<U, typename std::allocator_traits<Allocator>::template rebind_alloc<U>>;
+        };
+
+        /**
+         * Whether add_range reserves geometrically (at least twice the old capacity) for Storage, as
+         * push_back grows storages that relocate their elements. Storages that grow in place by
+         * blocks or by extending a mapping specialize it to false and get exactly what they need.
+         */
+        template<typename Storage> struct geometric_reserve : std::true_type {};
+
+        /**
+         * Erase every element of storage that satisfies pred, keeping the order of the rest
+         * Uses the storage's own erase_if when it has one (e.g. StringArenaStorage), one compaction pass otherwise
+         * @param limit Stop testing elements once this many were erased - the rest is moved down untested
+         * @return Number of elements erased
+         */
+        template<typename Storage, typename Predicate> 
+        size_t erase_if(Storage& storage, Predicate pred, size_t limit = static_cast<size_t>(-1)) {
+            if constexpr (requires { storage.erase_if(pred); }) {
+                return storage.erase_if(pred);
+            } else {
+                auto read = storage.begin();
+                auto last = storage.end();
+                size_t removed = 0;
+                while (read != last && !pred(*read)) {
+                    ++read;
+                }
+                auto write = read;
+                if (read != last) {
+                    ++removed;
+                    ++read;
+                }
+                while (read != last && removed < limit) {
+                    if (pred(*read)) {
+                        ++removed;
+                    } else {
+                        *write = std::move(*read);
+                        ++write;
+                    }
+                    ++read;
+                }
+                write = std::move(read, last, write);
+                storage.erase(write, storage.end());
+                return removed;
+            }
+        }
+
+        /**
+         * Types std::hash can hash
+         */
+        template<typename T> concept hashable = requires(const T& value) {
+            { std::hash<T>{}(value) } -> std::convertible_to<size_t>;
+        };
+
+        /**
+         * Default hash of HashValueIndex - std::hash<T>, made transparent for std::string so the
+         * std::string_view elements of StringArenaStorage are looked up without building a string
+         */
+        template<typename T> struct value_hash : std::hash<T> {};
+
+        template<> struct value_hash<std::string> {
+            using is_transparent = void;
+            size_t operator()(std::string_view value) const noexcept { return std::hash<std::string_view>{}(value); }
+        };
+
+        /**
+         * The value index a container keeps: ValueIndex rebound to the container's allocator when it
+         * allocates (HashValueIndex), ValueIndex itself otherwise
+         */
+        template<typename ValueIndex, typename Allocator> struct rebind_value_index {
+            using type = ValueIndex;
+        };
+
+        template<typename ValueIndex, typename Allocator> requires requires { typename ValueIndex::template rebind<Allocator>; }
+        struct rebind_value_index<ValueIndex, Allocator> {
+            using type = typename ValueIndex::template rebind<Allocator>;
+        };
+
+        template<typename Storage> struct is_bit_vector : std::false_type {};
+        template<typename A> struct is_bit_vector<std::vector<bool, A>> : std::true_type {};
+
+        /**
+         * Get the heap bytes held by a storage
+         * Uses the storage's own memory_bytes() when it has one, its capacity otherwise
+         */
+        template<typename Storage> size_t storage_bytes(const Storage& storage) {
+            if constexpr (requires { storage.memory_bytes(); }) {
+                return storage.memory_bytes();
+            } else if constexpr (is_bit_vector<Storage>::value) {
+                return (storage.capacity() + 7) / 8;
+            } else {
+                return storage.capacity() * sizeof(typename Storage::value_type);
+            }
+        }
+
+        /**
+         * Storage that keeps its elements in one array reachable through data()
+         */
+        template<typename Storage> concept contiguous_storage = requires(const Storage& storage) {
+            { storage.data() } -> std::convertible_to<const typename Storage::value_type*>;
+        };
+
+        /**
+         * Read state a sequential iterator keeps for its storage: Storage::scan_cursor when the
+         * storage has one (e.g. PackedStorage decodes a block at a time), plain element access otherwise.
+         * holds(index) is true when the cursor already has that element at hand
+         */
+        template<typename Storage> struct plain_cursor {
+            constexpr bool holds(size_t) const { return false; }
+            decltype(auto) read(const Storage& storage, size_t index) const { return storage[index]; }
+        };
+
+        template<typename Storage> struct scan_cursor {
+            using type = plain_cursor<Storage>;
+        };
+
+        template<typename Storage> requires requires { typename Storage::scan_cursor; } struct scan_cursor<Storage> {
+            using type = typename Storage::scan_cursor;
+        };
+
+        /**
+         * Default element access of IndexIterator - the owner's operator[]
+         */
+        struct subscript {
+            template<typename Owner> constexpr decltype(auto) operator()(Owner& owner, size_t index) const { return owner[index]; }
+        };
+
+        /**
+         * Cpp17 iterator category of an iterator whose operator* yields Reference. A forward iterator
+         * must hand out real references, so iterators over values (e.g. PackedStorage's T or
+         * StringArenaStorage's std::string_view) only claim input iteration to legacy algorithms;
+         * their iterator_concept still says random access
+         */
+        template<typename Reference> using legacy_iterator_category = 
+            std::conditional_t<std::is_reference_v<Reference>, std::random_access_iterator_tag, std::input_iterator_tag>;
+
+        /**
+         * Random access iterator that holds an owner and an index - the iterator of the storages
+         * whose elements are not a plain array (SegmentedStorage, StringArenaStorage, PackedStorage)
+         * and of MyStaticContainer
+         * Template parameter Owner is the (possibly const) class the iterator reads from
+         * Template parameter Reference is what dereferencing yields - a real reference or a value (e.g. std::string_view)
+         * Template parameter Access reads element index of the owner; defaults to owner[index]
+         */
+        template<typename Owner, typename Reference, typename Access = subscript> class IndexIterator {
+            Owner* owner = nullptr;
+            size_t index = 0;
+
+            template<typename, typename, typename> friend class IndexIterator;
+
+        public:
+            using iterator_category = legacy_iterator_category<Reference>;
+            using iterator_concept = std::random_access_iterator_tag;
+            using value_type = std::remove_cvref_t<Reference>;
+            using difference_type = std::ptrdiff_t;
+            using pointer = std::conditional_t<std::is_reference_v<Reference>, std::add_pointer_t<std::remove_reference_t<Reference>>, void>;
+            using reference = Reference;
+
+            constexpr IndexIterator() = default;
+            constexpr IndexIterator(Owner* container, size_t position) : owner(container), index(position) {}
+
+            // An iterator over a mutable owner converts to one over a const owner
+            template<typename OtherOwner, typename OtherReference>
+                requires (!std::is_same_v<OtherOwner, Owner> && std::is_convertible_v<OtherOwner*, Owner*>)
+            constexpr IndexIterator(const IndexIterator<OtherOwner, OtherReference, Access>& other) : owner(other.owner), index(other.index) {}
+
+            constexpr Reference operator*() const { return Access{}(*owner, index); }
+            constexpr pointer operator->() const requires std::is_reference_v<Reference> { return &**this; }
+            constexpr Reference operator[](difference_type n) const { return Access{}(*owner, index + n); }
+
+            constexpr IndexIterator& operator++() { ++index; return *this; }
+            constexpr IndexIterator operator++(int) { IndexIterator temp = *this; ++index; return temp; }
+            constexpr IndexIterator& operator--() { --index; return *this; }
+            constexpr IndexIterator operator--(int) { IndexIterator temp = *this; --index; return temp; }
+            constexpr IndexIterator& operator+=(difference_type n) { index += n; return *this; }
+            constexpr IndexIterator& operator-=(difference_type n) { index -= n; return *this; }
+
+            friend constexpr IndexIterator operator+(IndexIterator it, difference_type n) { return it += n; }
+            friend constexpr IndexIterator operator+(difference_type n, IndexIterator it) { return it += n; }
+            friend constexpr IndexIterator operator-(IndexIterator it, difference_type n) { return it -= n; }
+            friend constexpr difference_type operator-(const IndexIterator& lhs, const IndexIterator& rhs) {
+                return static_cast<difference_type>(lhs.index) - static_cast<difference_type>(rhs.index);
+            }
+
+            friend constexpr bool operator==(const IndexIterator& lhs, const IndexIterator& rhs) { return lhs.index == rhs.index; }
+            friend constexpr auto operator<=>(const IndexIterator& lhs, const IndexIterator& rhs) { return lhs.index <=> rhs.index; }
+        };
+
+    } // End of detail namespace
+
+    /**
+     * NoValueIndex - default value index policy of MyContainer: keeps nothing, remove() scans
+     */
+    struct NoValueIndex {
+        static constexpr bool enabled = false;
+
+        NoValueIndex() = default;
+        template<typename Allocator> explicit NoValueIndex(const Allocator&) {}
+        template<typename Allocator> NoValueIndex(const NoValueIndex&, const Allocator&) {}
+
+        template<typename V> void insert(const V&) {}
+        template<typename V> void erase_one(const V&) {}
+        template<typename V> void erase_all(const V&) {}
+        template<typename Storage> void rebuild(const Storage&) {}
+        void clear() {}
+        size_t memory_bytes() const { return 0; }
+    };
+
+    /**
+     * HashValueIndex - value index policy that counts the occurrences of every value in a hash table
+     *
+     * remove() of a missing value is detected in O(1) expected time without touching the elements,
+     * and a hit stops comparing as soon as all occurrences were found (the tail is moved down
+     * without comparisons). Costs one hash update per add.
+     *
+     * The table allocates through Allocator, which MyContainer rebinds to its own. Values are looked
+     * up as they are when they are T or Hash and KeyEqual are transparent (the default for
+     * std::string); a T is only built for a new entry.
+     */
+    template<typename T, typename Hash = detail::value_hash<T>, typename KeyEqual = std::equal_to<>, typename Allocator = std::allocator<T>> 
+    class HashValueIndex {
+        using EntryAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<std::pair<const T, size_t>>;
+
+        static constexpr bool TRANSPARENT = requires { typename Hash::is_transparent; typename KeyEqual::is_transparent; };
+
+        std::unordered_map<T, size_t, Hash, KeyEqual, EntryAllocator> counts;
+
+        /**
+         * Get the key to look value up by - value itself when the table takes it, a T otherwise
+         */
+        template<typename V> static decltype(auto) key(const V& value) {
+            if constexpr (std::is_same_v<V, T> || TRANSPARENT) {
+                return (value);
+            } else {
+                return T(value);
+            }
+        }
+
+    public:
+        static constexpr bool enabled = true;
+
+        template<typename OtherAllocator> using rebind = HashValueIndex<T, Hash, KeyEqual, OtherAllocator>;
+
+        HashValueIndex() = default;
+        explicit HashValueIndex(const Allocator& allocator) : counts(EntryAllocator(allocator)) {}
+        HashValueIndex(const HashValueIndex& other, const Allocator& allocator) : counts(other.counts, EntryAllocator(allocator)) {}
+
+        template<typename V> void insert(const V& value) {
+            if constexpr (std::is_same_v<V, T>) {
+                ++counts.try_emplace(value, 0).first->second;
+            } else {
+                auto it = counts.find(key(value));
+                if (it != counts.end()) {
+                    ++it->second;
+                } else {
+                    counts.emplace(T(value), 1);
+                }
+            }
+        }
+
+        template<typename V> void erase_one(const V& value) {
+            auto it = counts.find(key(value));
+            if (it != counts.end() && --it->second == 0) {
+                counts.erase(it);
+            }
+        }
+
+        template<typename V> void erase_all(const V& value) {
+            auto it = counts.find(key(value));
+            if (it != counts.end()) {
+                counts.erase(it);
+            }
+        }
+
+        template<typename Storage> void rebuild(const Storage& storage) {
+            counts.clear();
+            for (const auto& value : storage) {
+                insert(value);
+            }
+        }
+
+        void clear() { counts.clear(); }
+
+        /**
+         * Get the number of occurrences of a value
+         * @return Occurrences currently stored, 0 if absent
+         */
+        template<typename V> size_t count(const V& value) const {
+            auto it = counts.find(key(value));
+            return it == counts.end() ? 0 : it->second;
+        }
+
+        /**
+         * Approximate heap bytes: the bucket array plus one node per distinct value
+         */
+        size_t memory_bytes() const {
+            return counts.bucket_count() * sizeof(void*) + counts.size() * (sizeof(std::pair<const T, size_t>) + 2 * sizeof(void*));
+        }
+    };
+
+    /**
+     * Memory held by a container, in bytes (see MyContainer::memory_usage)
+     * Iterators are handles into the container and hold no copies, so they never add to these numbers
+     */
+    struct MemoryUsage {
+        size_t storage_bytes = 0;  // Element storage (shallow - memory owned by the elements themselves is not included)
+        size_t index_bytes = 0;    // Cached sorted index shared by the ordered iterators, plus any value index and tombstones
+        size_t peak_bytes = 0;     // High-water mark of storage_bytes + index_bytes
+
+        size_t total_bytes() const { return storage_bytes + index_bytes; }
+    };
     
     /**
      * MyContainer - A generic container class for comparable types
      * 
      * Template parameter T defaults to int but can be any comparable type (int, double, string, custom classes with operator< defined)
+     * Template parameter Allocator is used for the elements and, rebound, for the sorted and value indexes
+     * Template parameter Storage holds the elements; it must offer the std::vector operations the
+     * container uses (e.g. InlineStorage for small-buffer containers)
+     * Template parameter ValueIndex is NoValueIndex or HashValueIndex<T> (makes remove() skip the scan for missing values)
+     *
+     * Const member functions, iteration included, may be called from several threads at once;
+     * modifications need exclusive access, as with std::vector
      */
-    template<typename T = int> class MyContainer {
+    template<typename T = int, typename Allocator = std::allocator<T>, typename Storage = std::vector<T, Allocator>,
+             typename ValueIndex = NoValueIndex> 
+    class MyContainer {
+
+    public:
+        using value_type = T;
+        using allocator_type = Allocator;
+        using storage_type = Storage;
+        using const_reference = typename Storage::const_reference;  // const T&, or a view type (e.g. std::string_view)
+
+    private:
+        using AllocatorTraits = std::allocator_traits<Allocator>;
+
+        Storage elements;  // Internal storage for container elements
+        [[no_unique_address]] typename detail::rebind_value_index<ValueIndex, Allocator>::type value_index;  // Occurrences per value, kept in step with elements
+
+        /**
+         * Tombstones - bitmap of removed elements still present in storage
+         *
+         * With a compaction threshold set, removals mark elements dead here instead of shifting the
+         * storage, and iterators map live ranks to positions with select(). Positions past the end
+         * of the bitmap are live, so appending never touches it. Per-word live counts are rebuilt
+         * once after a burst of marks, which makes select() a binary search plus one word scan - and
+         * a pure read, so concurrent traversals can share it.
+         */
+        class Tombstones {
+        private:
+            using WordAllocator = typename AllocatorTraits::template rebind_alloc<std::uint64_t>;
+
+            std::vector<std::uint64_t, WordAllocator> dead;         // Bit i of word w - element 64w+i is dead
+            std::vector<std::uint64_t, WordAllocator> live_before;  // live_before[w] - live bits in words [0, w)
+            size_t dead_count = 0;
+
+        public:
+            explicit Tombstones(const Allocator& allocator = Allocator()) 
+                : dead(WordAllocator(allocator)), live_before(WordAllocator(allocator)) {}
+
+            Tombstones(const Tombstones& other, const Allocator& allocator) 
+                : dead(other.dead, WordAllocator(allocator)), live_before(other.live_before, WordAllocator(allocator)), 
+                  dead_count(other.dead_count) {}
+
+            /**
+             * Get the number of dead elements
+             */
+            size_t count() const { return dead_count; }
+
+            bool is_dead(size_t position) const {
+                size_t word = position / 64;
+                return word < dead.size() && (dead[word] >> (position % 64) & 1) != 0;
+            }
+
+            /**
+             * Mark a live element dead - call update_ranks() once the burst of marks is done
+             * @param position Index into elements
+             */
+            void mark(size_t position) {
+                size_t word = position / 64;
+                if (word >= dead.size()) {
+                    dead.resize(word + 1, 0);
+                }
+                dead[word] |= std::uint64_t{1} << (position % 64);
+                ++dead_count;
+            }
+
+            /**
+             * Rebuild the per-word live counts select() searches
+             */
+            void update_ranks() {
+                live_before.resize(dead.size() + 1);
+                live_before[0] = 0;
+                for (size_t w = 0; w < dead.size(); ++w) {
+                    live_before[w + 1] = live_before[w] + 64 - static_cast<size_t>(std::popcount(dead[w]));
+                }
+            }
+
+            /**
+             * Find the position of a live element
+             * @param rank Rank among the live elements, in insertion order
+             * @return Index into elements
+             */
+            size_t select(size_t rank) const {
+                if (rank >= live_before.back()) {
+                    return dead.size() * 64 + (rank - live_before.back());
+                }
+                // Last word with fewer than rank + 1 live bits before it
+                size_t word = static_cast<size_t>(std::upper_bound(live_before.begin(), live_before.end(), rank) - live_before.begin()) - 1;
+                std::uint64_t live = ~dead[word];
+                for (size_t skip = rank - live_before[word]; skip > 0; --skip) {
+                    live &= live - 1;
+                }
+                return word * 64 + static_cast<size_t>(std::countr_zero(live));
+            }
+
+            void clear() {
+                dead.clear();
+                live_before.clear();
+                dead_count = 0;
+            }
+
+            size_t memory_bytes() const { return detail::storage_bytes(dead) + detail::storage_bytes(live_before); }
+        };
+
+        Tombstones tombstones;            // Elements removed but not yet compacted away
+        double compaction_threshold = 0;  // Dead fraction that triggers compaction, 0 to remove immediately
+
+        /**
+         * LazySortedIndex - permutation of positions into elements that is sorted on demand
+         *
+         * Uses incremental quicksort: reading rank i partitions only the unsorted run that contains i,
+         * so taking the first k elements costs O(n + k log n) and a full traversal costs one quicksort.
+         * Runs that recurse too deep fall back to std::sort to keep the O(n log n) worst case.
+         *
+         * Once every rank is settled the index doubles as the sorted base of a log-structured index:
+         * positions appended to the container later form an unsorted tail that absorb_appended()
+         * sorts on its own and merges in, costing O(n + m log m) instead of a full re-sort.
+         *
+         * Dead elements (see Tombstones) are left out, so ranks always count live elements only.
+         *
+         * A storage that decodes on every read (one with a scan_cursor, such as PackedStorage) is
+         * decoded into keys once before sorting, so comparisons read plain values. The keys are
+         * dropped as soon as every rank is settled.
+         *
+         * Settling is the only write a const read makes, so it runs under the owner's index_mutex;
+         * once every rank is settled the index is read-only and at() takes no lock.
+         */
+        class LazySortedIndex {
+        private:
+            static constexpr size_t SMALL_RUN = 16;  // Runs up to this length are sorted directly
+
+            using PositionAllocator = typename AllocatorTraits::template rebind_alloc<size_t>;
+            using FlagAllocator = typename AllocatorTraits::template rebind_alloc<bool>;
+            using KeyAllocator = typename AllocatorTraits::template rebind_alloc<T>;
+
+            static constexpr bool DECODED_KEYS = !std::is_same_v<typename detail::scan_cursor<Storage>::type, detail::plain_cursor<Storage>>;
+
+            typename detail::rebind_storage<Storage, size_t, Allocator>::type positions;  // positions[rank] - index into elements
+            typename detail::rebind_storage<Storage, bool, Allocator>::type settled;      // settled[rank] - positions[rank] is in its final place
+            size_t settled_count = 0;
+            size_t covered;  // Elements (live or dead) the index was built over
+            std::vector<T, KeyAllocator> keys;  // keys[i] - decoded elements[i] while sorting, for DECODED_KEYS storage only
+            std::atomic<bool> ready;  // Every rank is settled - set last, so lock-free readers see a finished index
+
+            /**
+             * Get the order of two positions into source, decoding source into keys first if its
+             * reads decode
+             */
+            auto comparator(const Storage& source) {
+                if constexpr (DECODED_KEYS) {
+                    if (keys.size() != source.size()) {
+                        typename detail::scan_cursor<Storage>::type cursor;
+                        keys.clear();
+                        keys.reserve(source.size());
+                        for (size_t i = 0; i < source.size(); ++i) {
+                            keys.push_back(cursor.read(source, i));
+                        }
+                    }
+                    return [this](size_t a, size_t b) { return keys[a] < keys[b]; };
+                } else {
+                    return [&source](size_t a, size_t b) { return source[a] < source[b]; };
+                }
+            }
+
+            /**
+             * Mark the index fully sorted, releasing the decoded keys
+             */
+            void finish() {
+                keys.clear();
+                keys.shrink_to_fit();
+                ready.store(true, std::memory_order_release);
+            }
+
+            /**
+             * Partition the unsorted run around rank until rank holds its final position
+             */
+            void settle(size_t rank, const Storage& source) {
+                auto less = comparator(source);
+
+                size_t lo = rank;
+                size_t hi = rank + 1;
+                while (lo > 0 && !settled[lo - 1]) --lo;
+                while (hi < positions.size() && !settled[hi]) ++hi;
+
+                size_t depth_budget = 0;
+                for (size_t length = hi - lo; length > 1; length >>= 1) {
+                    depth_budget += 2;
+                }
+
+                while (true) {
+                    if (hi - lo <= SMALL_RUN || depth_budget-- == 0) {
+                        std::sort(positions.begin() + lo, positions.begin() + hi, less);
+                        for (size_t i = lo; i < hi; ++i) settled[i] = true;
+                        settled_count += hi - lo;
+                        return;
+                    }
+
+                    // Median of three pivot
+                    size_t first = positions[lo];
+                    size_t middle = positions[lo + (hi - lo) / 2];
+                    size_t last = positions[hi - 1];
+                    if (less(middle, first)) std::swap(first, middle);
+                    if (less(last, middle)) std::swap(middle, last);
+                    if (less(middle, first)) std::swap(first, middle);
+                    size_t pivot = middle;
+
+                    // Three-way partition: [lo, lt) < pivot, [lt, gt) == pivot, [gt, hi) > pivot
+                    size_t lt = lo;
+                    size_t gt = hi;
+                    size_t i = lo;
+                    while (i < gt) {
+                        if (less(positions[i], pivot)) {
+                            std::swap(positions[lt++], positions[i++]);
+                        } else if (less(pivot, positions[i])) {
+                            std::swap(positions[i], positions[--gt]);
+                        } else {
+                            ++i;
+                        }
+                    }
+                    for (size_t k = lt; k < gt; ++k) settled[k] = true;
+                    settled_count += gt - lt;
+
+                    if (rank < lt) {
+                        hi = lt;
+                    } else if (rank >= gt) {
+                        lo = gt;
+                    } else {
+                        return;
+                    }
+                }
+            }
+
+        public:
+            LazySortedIndex(const Storage& source, const Tombstones& dead, const Allocator& allocator) 
+                : positions(source.size() - dead.count(), PositionAllocator(allocator)), 
+                  settled(source.size() - dead.count(), false, FlagAllocator(allocator)), covered(source.size()), 
+                  keys(KeyAllocator(allocator)), ready(source.size() == dead.count()) {
+                size_t rank = 0;
+                for (size_t i = 0; i < covered; ++i) {
+                    if (dead.count() == 0 || !dead.is_dead(i)) {
+                        positions[rank++] = i;
+                    }
+                }
+                if (!ready.load()) {
+                    comparator(source);  // Decode up front, so the owner's memory accounting sees the keys
+                }
+            }
+
+            LazySortedIndex(LazySortedIndex&& other) 
+                : positions(std::move(other.positions)), settled(std::move(other.settled)), settled_count(other.settled_count), 
+                  covered(other.covered), keys(std::move(other.keys)), ready(other.ready.load()) {}
+
+            LazySortedIndex& operator=(LazySortedIndex&& other) {
+                positions = std::move(other.positions);
+                settled = std::move(other.settled);
+                settled_count = other.settled_count;
+                covered = other.covered;
+                keys = std::move(other.keys);
+                ready.store(other.ready.load());
+                return *this;
+            }
+
+            /**
+             * Get the number of elements, live or dead, the index covers
+             */
+            size_t size() const { return covered; }
+
+            size_t memory_bytes() const { return detail::storage_bytes(positions) + detail::storage_bytes(settled) + detail::storage_bytes(keys); }
+
+            /**
+             * Check whether every rank is settled, i.e. the index is fully sorted
+             * @return true if the index can serve as a sorted base for appended elements
+             */
+            bool complete() const { return settled_count == positions.size(); }
+
+            /**
+             * Merge positions appended to source since this index was built into the sorted base
+             * Must only be called on a complete index
+             * @param source The elements the positions refer to, with the new ones at the end
+             */
+            void absorb_appended(const Storage& source) {
+                auto less = comparator(source);
+
+                // Appended elements are always live - removals drop the index
+                size_t base_size = positions.size();
+                positions.resize(base_size + source.size() - covered);
+                for (size_t i = base_size; i < positions.size(); ++i) {
+                    positions[i] = covered + (i - base_size);
+                }
+                covered = source.size();
+                std::sort(positions.begin() + base_size, positions.end(), less);
+
+                // Merge from the back through a copy of the tail - std::inplace_merge would take its
+                // buffer from the global heap instead of the container's allocator. Equal elements
+                // keep base before tail, as in a stable merge.
+                decltype(positions) tail(positions.begin() + base_size, positions.end(), positions.get_allocator());
+                size_t base = base_size;
+                size_t rest = tail.size();
+                size_t write = positions.size();
+                while (rest > 0) {
+                    if (base > 0 && less(tail[rest - 1], positions[base - 1])) {
+                        positions[--write] = positions[--base];
+                    } else {
+                        positions[--write] = tail[--rest];
+                    }
+                }
+
+                settled.resize(positions.size(), true);
+                settled_count = positions.size();
+                finish();
+            }
+
+            /**
+             * Get the position of the element with the given rank, sorting just enough to find it
+             * Safe to call from several threads: an unfinished index is settled under lock, and a
+             * settled rank is never moved again, so its position can be read after unlocking
+             * @param rank Rank in iteration order
+             * @param source The elements the positions refer to
+             * @param lock The owner's index_mutex
+             * @return Index into source
+             */
+            size_t at(size_t rank, const Storage& source, std::mutex& lock) {
+                if (!ready.load(std::memory_order_acquire)) {
+                    std::lock_guard<std::mutex> guard(lock);
+                    if (!settled[rank]) {
+                        settle(rank, source);
+                        if (complete()) {
+                            finish();
+                        }
+                    }
+                }
+                return positions[rank];
+            }
+
+            /**
+             * Settle every rank that is not settled yet - each unsorted run is sorted on its own,
+             * so ranks that were already read keep their positions
+             * @param source The elements the positions refer to
+             */
+            void settle_all(const Storage& source) {
+                if (ready.load(std::memory_order_acquire)) {
+                    return;
+                }
+                auto less = comparator(source);
+                size_t lo = 0;
+                while (lo < positions.size()) {
+                    if (settled[lo]) {
+                        ++lo;
+                        continue;
+                    }
+                    size_t hi = lo + 1;
+                    while (hi < positions.size() && !settled[hi]) ++hi;
+                    std::sort(positions.begin() + lo, positions.begin() + hi, less);
+                    for (size_t i = lo; i < hi; ++i) settled[i] = true;
+                    settled_count += hi - lo;
+                    lo = hi;
+                }
+                finish();
+            }
+        };
+
+        // Ascending permutation of positions into elements, shared by all ordered iterators: ascending
+        // reads it front to back, descending back to front and side-cross from alternating ends, so
+        // one (lazy) sort per container version serves all three orders. Sorting moves indices and
+        // never copies T. remove() drops the index, while add() keeps a fully sorted one as the base
+        // for merging the new tail. The container owns it and iterators only keep a plain pointer,
+        // so like std::vector iterators, all iterators are invalidated by any modification and must
+        // not outlive the container. Every dereference compares the iterator's generation with the
+        // container's, so using an invalidated iterator throws instead of reading a stale index.
+        mutable std::optional<LazySortedIndex> sorted_index;
+
+        // Const reads may build, extend and settle the sorted index, and update peak_bytes. These
+        // writes happen under this lock, so any number of threads can read one container at once
+        // (as with std::vector, modifications still need exclusive access).
+        mutable std::mutex index_mutex;
+
+        size_t generation = 0;  // Bumped by every modification, lets iterators detect that they are stale
+
+        mutable size_t peak_bytes = 0;  // High-water mark reported by memory_usage()
+        size_t memory_limit = 0;        // Bytes above which caches are shed, 0 for no limit
+
+        /**
+         * Measure the memory held right now
+         * @return Storage and index bytes, with peak_bytes as recorded so far
+         */
+        MemoryUsage current_usage() const {
+            MemoryUsage usage;
+            usage.storage_bytes = detail::storage_bytes(elements);
+            usage.index_bytes = (sorted_index ? sorted_index->memory_bytes() : 0) + value_index.memory_bytes() + tombstones.memory_bytes();
+            usage.peak_bytes = peak_bytes;
+            return usage;
+        }
+
+        void record_usage() const {
+            peak_bytes = std::max(peak_bytes, current_usage().total_bytes());
+        }
+
+        /**
+         * Record the memory held after a modification and drop the sorted index if it puts the
+         * container over its memory limit
+         */
+        void account_memory() {
+            record_usage();
+            if (memory_limit != 0 && sorted_index && current_usage().total_bytes() > memory_limit) {
+                sorted_index.reset();
+            }
+        }
+
+        /**
+         * Drop all cached indexes and invalidate outstanding iterators - called after every
+         * modification of elements
+         */
+        void invalidate() {
+            sorted_index.reset();
+            ++generation;
+            account_memory();
+        }
+
+        /**
+         * Invalidate outstanding iterators without dropping the sorted index - for changes that keep
+         * existing positions (appends, reallocation). The index absorbs any new tail on its next use.
+         */
+        void invalidate_iterators() {
+            ++generation;
+            account_memory();
+        }
+
+        /**
+         * Get the sorted index, bringing it up to date with elements first
+         * A complete index merges the appended tail; a partially sorted one, or one over more
+         * elements than there are now, is rebuilt
+         * @return The lazily sorted ascending permutation
+         */
+        LazySortedIndex& get_sorted_index() const {
+            std::lock_guard<std::mutex> guard(index_mutex);
+            if (sorted_index && sorted_index->size() != elements.size()) {
+                if (sorted_index->complete() && elements.size() > sorted_index->size()) {
+                    sorted_index->absorb_appended(elements);
+                } else {
+                    sorted_index.reset();
+                }
+            }
+            if (!sorted_index) {
+                sorted_index.emplace(elements, tombstones, elements.get_allocator());
+            }
+            record_usage();
+            return *sorted_index;
+        }
+
+        /**
+         * Map a rank in insertion order to an index into elements, skipping dead elements
+         * @param rank Rank among the live elements
+         * @return Index into elements
+         */
+        size_t physical(size_t rank) const {
+            return tombstones.count() == 0 ? rank : tombstones.select(rank);
+        }
+
+        /**
+         * Drop the dead elements from storage in one compaction pass
+         * Leaves the sorted index and iterators to the caller
+         */
+        void compact_tombstones() {
+            size_t position = 0;
+            detail::erase_if(elements, [this, &position](const auto&) { return tombstones.is_dead(position++); }, tombstones.count());
+            tombstones.clear();
+        }
+
+        /**
+         * Compact the dead elements of file-backed storage (MappedStorage) before it is let go - its
+         * header counts every stored element, so tombstones alone would come back on reopen
+         */
+        void persist_removals() {
+            if constexpr (requires { elements.is_file_backed(); }) {
+                if (tombstones.count() > 0 && elements.is_file_backed()) {
+                    compact_tombstones();
+                }
+            }
+        }
+
+        /**
+         * Check whether dead elements make up more than the compaction threshold allows
+         */
+        bool over_compaction_threshold() const {
+            return static_cast<double>(tombstones.count()) > compaction_threshold * static_cast<double>(elements.size());
+        }
+
+        /**
+         * Remove the live elements that satisfy pred - the shared core of all removals
+         * Without a compaction threshold this is one compaction pass over elements. With one, matches
+         * are only marked dead, and the storage is compacted once the dead fraction passes the threshold.
+         * @param pred Called once per live element, in insertion order, until limit elements matched
+         * @param limit Stop after this many removals
+         * @return Number of elements removed
+         */
+        template<typename Predicate> size_t erase_where(Predicate pred, size_t limit = static_cast<size_t>(-1)) {
+            if (compaction_threshold == 0) {
+                return detail::erase_if(elements, pred, limit);
+            }
+
+            size_t removed = 0;
+            for (size_t i = 0; i < elements.size() && removed < limit; ++i) {
+                if (!tombstones.is_dead(i) && pred(elements[i])) {
+                    tombstones.mark(i);
+                    ++removed;
+                }
+            }
+            if (removed == 0) {
+                return 0;  // Nothing changed - a miss leaves storage and iterators alone
+            }
+            if (over_compaction_threshold()) {
+                compact_tombstones();
+            } else {
+                tombstones.update_ranks();
+            }
+            return removed;
+        }
+
+    public:
+        
+        // ================== CONSTRUCTORS & DESTRUCTOR==================
+        
+        /**
+         * Default constructor - creates empty container
+         */
+        MyContainer() = default;
+
+        /**
+         * Allocator constructor - creates empty container that allocates through allocator
+         * @param allocator Used for the elements and the sorted index
+         */
+        explicit MyContainer(const Allocator& allocator) : elements(allocator), value_index(allocator), tombstones(allocator) {}
+        
+        /**
+         * Copy constructor - creates deep copy of another container
+         */
+        MyContainer(const MyContainer& other) 
+            : elements(other.elements), value_index(other.value_index), tombstones(other.tombstones), 
+              compaction_threshold(other.compaction_threshold), memory_limit(other.memory_limit) {}
+
+        /**
+         * Allocator-extended copy constructor - creates deep copy that allocates through allocator
+         */
+        MyContainer(const MyContainer& other, const Allocator& allocator) 
+            : elements(other.elements, allocator), value_index(other.value_index, allocator), tombstones(other.tombstones, allocator), 
+              compaction_threshold(other.compaction_threshold), memory_limit(other.memory_limit) {}
+
+        /**
+         * Move constructor - takes over the elements and the sorted index, leaves other empty
+         */
+        MyContainer(MyContainer&& other) noexcept(std::is_nothrow_move_constructible_v<Storage>)
+            : elements(std::move(other.elements)), value_index(std::move(other.value_index)),
+              tombstones(std::move(other.tombstones)), compaction_threshold(other.compaction_threshold),
+              sorted_index(std::move(other.sorted_index)), peak_bytes(other.peak_bytes), memory_limit(other.memory_limit) {
+            other.elements.clear();
+            other.value_index.clear();
+            other.tombstones.clear();
+            other.invalidate();
+        }
+
+        /**
+         * Initializer list constructor - stores all values with a single allocation
+         * @param values The elements to add, in insertion order
+         */
+        MyContainer(std::initializer_list<T> values, const Allocator& allocator = Allocator()) 
+            : elements(values, allocator), value_index(allocator), tombstones(allocator) {
+            value_index.rebuild(elements);
+        }
+
+        /**
+         * Range constructor - stores [first, last) in insertion order
+         * Forward iterators let the storage grow once
+         */
+        template<std::input_iterator InputIt> MyContainer(InputIt first, InputIt last, const Allocator& allocator = Allocator()) 
+            : elements(first, last, allocator), value_index(allocator), tombstones(allocator) {
+            value_index.rebuild(elements);
+        }
+
+        /**
+         * Adopting constructor - takes over existing storage (e.g. a std::vector) without copying any element
+         * @param values The elements, in insertion order
+         */
+        explicit MyContainer(Storage&& values) noexcept(std::is_nothrow_move_constructible_v<Storage>) 
+            : elements(std::move(values)), value_index(elements.get_allocator()), tombstones(elements.get_allocator()) {
+            value_index.rebuild(elements);
+        }
+        
+        /**
+         * Copy assignment operator - assigns content from another container
+         */
+        MyContainer& operator=(const MyContainer& other) {
+            if (this != &other) {
+                elements = other.elements;
+                value_index = other.value_index;
+                tombstones = other.tombstones;
+                compaction_threshold = other.compaction_threshold;
+                memory_limit = other.memory_limit;
+                invalidate();
+            }
+            return *this;
+        }
+
+        /**
+         * Move assignment operator - takes over the elements and the sorted index, leaves other empty
+         * The index is only taken over when its memory ends up owned by this container's allocator
+         */
+        MyContainer& operator=(MyContainer&& other) noexcept(std::is_nothrow_move_assignable_v<Storage>) {
+            if (this != &other) {
+                bool keeps_index = AllocatorTraits::propagate_on_container_move_assignment::value 
+                                   || elements.get_allocator() == other.elements.get_allocator();
+                persist_removals();
+                elements = std::move(other.elements);
+                value_index = std::move(other.value_index);
+                tombstones = std::move(other.tombstones);
+                compaction_threshold = other.compaction_threshold;
+                peak_bytes = other.peak_bytes;
+                memory_limit = other.memory_limit;
+                if (keeps_index) {
+                    sorted_index = std::move(other.sorted_index);
+                } else {
+                    sorted_index.reset();
+                }
+                ++generation;
+                other.elements.clear();
+                other.value_index.clear();
+                other.tombstones.clear();
+                other.invalidate();
+            }
+            return *this;
+        }
+        
+        /**
+         * Destructor - compacts pending tombstones of file-backed storage, frees the rest
+         */
+        ~MyContainer() {
+            persist_removals();
+        }
+
+        // ================== BASIC OPERATIONS ==================
+        
+        /**
+         * Add an element to the container
+         * @param element The element to add to the container
+         */
+        void add(const T& element) {
+            elements.push_back(element);
+            value_index.insert(elements[elements.size() - 1]);  // element may have been a stored element that push_back moved
+            invalidate_iterators();
+        }
+
+        /**
+         * Add an element to the container by moving it in
+         * @param element The element to move into the container
+         */
+        void add(T&& element) {
+            elements.push_back(std::move(element));
+            value_index.insert(elements[elements.size() - 1]);
+            invalidate_iterators();
+        }
+
+        /**
+         * Add an element from its view type without building a temporary T
+         * Only for storages whose elements are views (e.g. std::string_view for StringArenaStorage)
+         * @param element Anything convertible to the storage's view type
+         */
+        template<typename U> 
+            requires (!std::is_reference_v<const_reference> && !std::is_same_v<std::remove_cvref_t<U>, T> 
+                      && std::is_convertible_v<U&&, const_reference>)
+        void add(U&& element) {
+            elements.push_back(const_reference(std::forward<U>(element)));
+            value_index.insert(elements[elements.size() - 1]);
+            invalidate_iterators();
+        }
+
+        /**
+         * Construct an element in place at the end of the container
+         * @param args Arguments forwarded to the constructor of T
+         */
+        template<typename... Args> void emplace(Args&&... args) {
+            elements.emplace_back(std::forward<Args>(args)...);
+            value_index.insert(elements[elements.size() - 1]);
+            invalidate_iterators();
+        }
+
+        /**
+         * Add all elements of [first, last) in order
+         * Forward iterators let the storage grow once for the whole range
+         * @param first Beginning of the range
+         * @param last End of the range
+         */
+        template<std::input_iterator InputIt> void add_range(InputIt first, InputIt last) {
+            if constexpr (std::forward_iterator<InputIt>) {
+                // Grow relocating storage geometrically, like push_back - an exact reserve would make many
+                // small ranges quadratic. Other storages take exactly what the range needs
+                size_t needed = elements.size() + static_cast<size_t>(std::distance(first, last));
+                if (needed > elements.capacity()) {
+                    if constexpr (detail::geometric_reserve<Storage>::value) {
+                        elements.reserve(std::max(needed, 2 * elements.capacity()));
+                    } else {
+                        elements.reserve(needed);
+                    }
+                }
+            }
+            for (; first != last; ++first) {
+                elements.emplace_back(*first);
+                value_index.insert(elements[elements.size() - 1]);
+            }
+            invalidate_iterators();
+        }
+
+        /**
+         * Reserve storage for at least capacity elements
+         * @param capacity The number of elements to make room for
+         */
+        void reserve(size_t capacity) {
+            elements.reserve(capacity);
+            invalidate_iterators();
+        }
+
+        /**
+         * Release unused storage capacity, compacting away dead elements first
+         */
+        void shrink_to_fit() {
+            if (tombstones.count() > 0) {
+                compact_tombstones();
+                sorted_index.reset();
+            }
+            elements.shrink_to_fit();
+            invalidate_iterators();
+        }
+
+        /**
+         * Remove all occurrences of an element from the container
+         * With HashValueIndex a missing element is rejected without scanning
+         * @param element The element to remove
+         * @throws std::runtime_error if element is not found in container
+         */
+        void remove(const T& element) {
+            if (try_remove(element) == 0) {
+                throw std::runtime_error("Element was not found in the container");
+            }
+        }
+
+        /**
+         * Remove all occurrences of an element, without throwing when there are none
+         * A single find-and-compact pass; with HashValueIndex a miss touches no element and
+         * comparing stops after the last occurrence
+         * @param element The element to remove
+         * @return Number of elements removed (0 if element was not found)
+         */
+        size_t try_remove(const T& element) {
+            auto matches = [&element](const auto& stored) { return stored == element; };
+            size_t removed;
+
+            if constexpr (ValueIndex::enabled) {
+                size_t occurrences = value_index.count(element);
+                if (occurrences == 0) {
+                    return 0;
+                }
+                removed = erase_where(matches, occurrences);
+                value_index.erase_all(element);
+            } else {
+                removed = erase_where(matches);
+            }
+
+            if (removed > 0) {
+                invalidate();
+            }
+            return removed;
+        }
+
+        /**
+         * Remove every element that satisfies a predicate, in one compaction pass
+         * @param pred Called once per element, in insertion order
+         * @return Number of elements removed
+         */
+        template<typename Predicate> size_t remove_if(Predicate pred) {
+            size_t removed = erase_where([this, &pred](const auto& stored) {
+                if (pred(stored)) {
+                    value_index.erase_one(stored);
+                    return true;
+                }
+                return false;
+            });
+
+            if (removed > 0) {
+                invalidate();
+            }
+            return removed;
+        }
+
+        /**
+         * Remove the first occurrence of an element only, without throwing when there is none
+         * @param element The element to remove
+         * @return true if an element was removed
+         */
+        bool erase_first(const T& element) {
+            if constexpr (ValueIndex::enabled) {
+                if (value_index.count(element) == 0) {
+                    return false;
+                }
+            }
+
+            bool found = false;
+            auto first_match = [&element, &found](const auto& stored) {
+                if (!found && stored == element) {
+                    found = true;
+                    return true;
+                }
+                return false;
+            };
+            erase_where(first_match, 1);
+
+            if (found) {
+                value_index.erase_one(element);
+                invalidate();
+            }
+            return found;
+        }
+
+        /**
+         * Remove all occurrences of every value in a range, in one compaction pass
+         * The values go into a probe set first - a hash set when T is hashable, a sorted vector
+         * otherwise - so removing k values costs O(n + k) instead of k full scans. The result is the
+         * same as calling remove() for each value, except that missing values are simply skipped.
+         * @param values The values to remove (duplicates are fine)
+         * @return Number of elements removed
+         */
+        template<std::ranges::input_range Range> size_t remove_all(Range&& values) {
+            using ProbeAllocator = typename AllocatorTraits::template rebind_alloc<T>;
+            size_t removed = 0;
+
+            if constexpr (std::is_same_v<std::remove_cvref_t<const_reference>, T> && detail::hashable<T>) {
+                std::unordered_set<T, std::hash<T>, std::equal_to<T>, ProbeAllocator> probe(0, std::hash<T>(), std::equal_to<T>(), 
+                                                                                            ProbeAllocator(get_allocator()));
+                size_t occurrences = 0;
+                for (auto&& value : values) {
+                    if constexpr (ValueIndex::enabled) {
+                        // Values the index does not know are dropped before the scan
+                        size_t count = value_index.count(value);
+                        if (count == 0 || !probe.insert(T(value)).second) continue;
+                        occurrences += count;
+                    } else {
+                        probe.insert(T(value));
+                    }
+                }
+                if (probe.empty()) {
+                    return 0;
+                }
+                size_t limit = ValueIndex::enabled ? occurrences : static_cast<size_t>(-1);
+                removed = erase_where([&probe](const auto& stored) { return probe.count(stored) != 0; }, limit);
+                for (const T& value : probe) {
+                    value_index.erase_all(value);
+                }
+            } else {
+                // Sorted probe - std::less<> also compares view-typed elements (e.g. std::string_view) with T
+                std::vector<T, ProbeAllocator> probe{ProbeAllocator(get_allocator())};
+                for (auto&& value : values) {
+                    probe.emplace_back(value);
+                }
+                std::sort(probe.begin(), probe.end());
+                probe.erase(std::unique(probe.begin(), probe.end()), probe.end());
+                if (probe.empty()) {
+                    return 0;
+                }
+                removed = erase_where([&probe](const auto& stored) { 
+                    return std::binary_search(probe.begin(), probe.end(), stored, std::less<>()); 
+                });
+                for (const T& value : probe) {
+                    value_index.erase_all(value);
+                }
+            }
+
+            if (removed > 0) {
+                invalidate();
+            }
+            return removed;
+        }
+
+        /**
+         * Remove all occurrences of every listed value, in one compaction pass
+         * @param values The values to remove
+         * @return Number of elements removed
+         */
+        size_t remove_all(std::initializer_list<T> values) {
+            return remove_all(std::ranges::subrange(values.begin(), values.end()));
+        }
 
-    private:
-        std::vector<T> elements;  // Internal storage for container elements
+        /**
+         * Get the number of elements in the container
+         * @return The size of the container
+         */
+        size_t size() const {
+            return elements.size() - tombstones.count();
+        }
 
-    public:
-        
-        // ================== CONSTRUCTORS & DESTRUCTOR==================
-        
         /**
-         * Default constructor - creates empty container
+         * Get the number of elements the container can hold without reallocating
+         * @return The capacity of the storage
          */
-        MyContainer() = default;
-        
+        size_t capacity() const {
+            return elements.capacity();
+        }
+
         /**
-         * Copy constructor - creates deep copy of another container
+         * Get the allocator used by the container
+         * @return Copy of the allocator
          */
-        MyContainer(const MyContainer& other) : elements(other.elements) {}
-        
+        Allocator get_allocator() const {
+            return elements.get_allocator();
+        }
+
         /**
-         * Copy assignment operator - assigns content from another container
+         * Check if container is empty
+         * @return true if container has no elements
          */
-        MyContainer& operator=(const MyContainer& other) {
-            if (this != &other) {
-                elements = other.elements;
+        bool empty() const {
+            return size() == 0;
+        }
+
+        // ================== DEFERRED COMPACTION ==================
+
+        /**
+         * Switch removals to tombstones: removed elements are only marked dead in a side bitmap and
+         * skipped by every iteration order, and the storage is compacted in one pass once dead
+         * elements make up more than the given fraction of it. A burst of k removals then costs k
+         * lookups plus one compaction, instead of shifting the storage k times. Dead elements stay in
+         * the storage until then; a file-backed MappedStorage is compacted before the container
+         * lets go of it, so removed elements never come back when the file is reopened.
+         * @param fraction Dead fraction in [0, 1) that triggers compaction; 0 (the default) removes
+         * immediately. Pending tombstones that already exceed the new fraction are compacted now
+         * @throws std::invalid_argument if fraction is outside [0, 1)
+         */
+        void set_compaction_threshold(double fraction) {
+            if (!(fraction >= 0 && fraction < 1)) {
+                throw std::invalid_argument("Compaction threshold must be in [0, 1)");
+            }
+            compaction_threshold = fraction;
+            if (over_compaction_threshold()) {
+                compact();
             }
-            return *this;
         }
-        
+
         /**
-         * Destructor - default cleanup
+         * Get the dead fraction that triggers compaction
+         * @return The threshold, 0 if removals are immediate
          */
-        ~MyContainer() = default;
+        double get_compaction_threshold() const {
+            return compaction_threshold;
+        }
 
-        // ================== BASIC OPERATIONS ==================
-        
         /**
-         * Add an element to the container
-         * @param element The element to add to the container
+         * Get the number of removed elements still waiting for compaction
+         * @return Number of tombstones
          */
-        void add(const T& element) {
-            elements.push_back(element);
+        size_t tombstone_count() const {
+            return tombstones.count();
         }
 
         /**
-         * Remove all occurrences of an element from the container
-         * @param element The element to remove
-         * @throws std::runtime_error if element is not found in container
+         * Drop all dead elements from storage now, in one pass
+         * Invalidates outstanding iterators if there was anything to compact
          */
-        void remove(const T& element) {
-            auto it = std::find(elements.begin(), elements.end(), element);
-            if (it == elements.end()) {
-                throw std::runtime_error("Element was not found in the container");
+        void compact() {
+            if (tombstones.count() > 0) {
+                compact_tombstones();
+                invalidate();
             }
-            
-            // Remove all occurrences
-            elements.erase(
-                std::remove(elements.begin(), elements.end(), element),
-                elements.end()
-            );
         }
 
+        // ================== MEMORY ACCOUNTING ==================
+
         /**
-         * Get the number of elements in the container
-         * @return The size of the container
+         * Report the memory held by the container
+         * @return Bytes held by the element storage and the cached sorted index, and their high-water mark
          */
-        size_t size() const {
-            return elements.size();
+        MemoryUsage memory_usage() const {
+            std::lock_guard<std::mutex> guard(index_mutex);
+            record_usage();
+            return current_usage();
         }
 
         /**
-         * Check if container is empty
-         * @return true if container has no elements
+         * Cap the memory the container keeps in caches
+         * After any modification that leaves storage + index above the limit, the sorted index is
+         * dropped instead of being kept for merging. The element storage itself is never shed, and an
+         * ordered traversal still builds the index it needs.
+         * @param bytes The limit in bytes, 0 to remove it
          */
-        bool empty() const {
-            return elements.empty();
+        void set_memory_limit(size_t bytes) {
+            memory_limit = bytes;
+            if (memory_limit != 0 && current_usage().total_bytes() > memory_limit) {
+                release_caches();
+            }
+        }
+
+        /**
+         * Get the cache memory limit
+         * @return The limit in bytes, 0 if none
+         */
+        size_t get_memory_limit() const {
+            return memory_limit;
+        }
+
+        /**
+         * Drop the sorted index - it is rebuilt lazily by the next ordered traversal
+         * Invalidates outstanding iterators
+         */
+        void release_caches() {
+            sorted_index.reset();
+            ++generation;
         }
 
         /**
@@ -102,22 +1401,22 @@ namespace ex4 {
          * @param container The container to print
          * @return Reference to the output stream for chaining
          */
-        friend std::ostream& operator<<(std::ostream& os, const MyContainer<T>& container) {
+        friend std::ostream& operator<<(std::ostream& os, const MyContainer& container) {
             os << "[";
-            if (container.elements.empty()) {
+            if (container.empty()) {
                 os << "]";
                 return os;
             }
             
-            for (size_t i = 0; i < container.elements.size(); ++i) {
+            for (size_t i = 0; i < container.size(); ++i) {
                 // Add quotes for strings to make them clearer
                 if constexpr (std::is_same_v<T, std::string>) {
-                    os << "\"" << container.elements[i] << "\"";
+                    os << "\"" << container.elements[container.physical(i)] << "\"";
                 } else {
-                    os << container.elements[i];
+                    os << container.elements[container.physical(i)];
                 }
                 
-                if (i < container.elements.size() - 1) { 
+                if (i < container.size() - 1) { 
                     os << ", ";
                 }
             }
@@ -126,105 +1425,200 @@ namespace ex4 {
         }
 
         // ================== ITERATOR CLASSES ==================
+
+        /**
+         * Get a pointer into the element array of contiguous storage
+         * @param storage The storage
+         * @param offset Element offset from the start of the array
+         * @return storage.data() + offset, or nullptr when Storage is not contiguous (e.g. SegmentedStorage)
+         */
+        static const T* contiguous_data(const Storage& storage, size_t offset = 0) {
+            if constexpr (detail::contiguous_storage<Storage>) {
+                return storage.data() + offset;
+            } else {
+                return nullptr;
+            }
+        }
         
         /**
-         * AscendingIterator - sorts elements from smallest to largest
-         * Example: [7,15,6,1,2] -> 1,2,6,7,15
+         * IteratorBase - random-access operations shared by all iterator classes (CRTP)
+         * Derived classes keep their own view of the elements and only provide operator*.
+         * Positions are plain indices, so stepping, jumping and distances are all O(1).
+         * Iterators are small trivially copyable handles, so postfix operators cost the same as prefix.
          */
-        class AscendingIterator {
-        private:
-            std::vector<T> sorted_elements;
+        template<typename Derived> class IteratorBase {
+        protected:
             size_t current_index;
-            const MyContainer<T>* owner;
+            const MyContainer* owner;
+            size_t generation;  // Owner's generation when this iterator was created
 
-        public:
-            AscendingIterator(const std::vector<T>& original_elements, size_t index, const MyContainer<T>* container_owner) 
-                : sorted_elements(original_elements), current_index(index), owner(container_owner) {
-                std::sort(sorted_elements.begin(), sorted_elements.end());
-            }
+            IteratorBase() : current_index(0), owner(nullptr), generation(0) {}
+
+            IteratorBase(size_t index, const MyContainer* container_owner) 
+                : current_index(index), owner(container_owner), generation(container_owner->generation) {}
 
             /**
-             * Dereference operator
-             * @return Reference to the current element
-             * @throws std::out_of_range if iterator is out of bounds
+             * Check that the owner was not modified since this iterator was created
+             * Runs in every build - it is one comparison, and it keeps a stale iterator from reading
+             * through a sorted index that was dropped or rebuilt
+             * @throws std::runtime_error if the iterator was invalidated by a modification of the owner
              */
-            const T& operator*() const { 
-                if (current_index >= sorted_elements.size()) {
-                    throw std::out_of_range("Iterator out of bounds");
+            void check_valid() const {
+                if (generation != owner->generation) {
+                    throw std::runtime_error("Iterator used after the container was modified");
                 }
-                return sorted_elements[current_index]; 
             }
 
+        private:
+            Derived& self() { return static_cast<Derived&>(*this); }
+            const Derived& self() const { return static_cast<const Derived&>(*this); }
+
+        public:
+            using iterator_category = detail::legacy_iterator_category<const_reference>;
+            using iterator_concept = std::random_access_iterator_tag;
+            using value_type = std::remove_cvref_t<const_reference>;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const value_type*;
+            using reference = const_reference;
+
+            /**
+             * Member access operator - only for storages that hand out real references
+             * @return Pointer to the current element
+             */
+            pointer operator->() const requires std::is_reference_v<reference> { return &*self(); }
+
+            /**
+             * Subscript operator
+             * @param n Offset from the current position
+             * @return Reference to the element n positions away
+             */
+            reference operator[](difference_type n) const { return *(self() + n); }
+
             /**
              * Pre-increment operator
              * @return Reference to this iterator after incrementing
              */
-            AscendingIterator& operator++() { ++current_index; return *this; }
-            
+            Derived& operator++() { ++current_index; return self(); }
+
             /**
              * Post-increment operator
              * @return Copy of iterator before incrementing
              */
-            AscendingIterator operator++(int) {
-                AscendingIterator temp = *this;
+            Derived operator++(int) {
+                Derived temp = self();
                 ++current_index;
                 return temp;
             }
-            
-            bool operator==(const AscendingIterator& other) const { 
-                return owner == other.owner && current_index == other.current_index; 
+
+            /**
+             * Pre-decrement operator
+             * @return Reference to this iterator after decrementing
+             */
+            Derived& operator--() { --current_index; return self(); }
+
+            /**
+             * Post-decrement operator
+             * @return Copy of iterator before decrementing
+             */
+            Derived operator--(int) {
+                Derived temp = self();
+                --current_index;
+                return temp;
+            }
+
+            Derived& operator+=(difference_type n) { current_index += n; return self(); }
+            Derived& operator-=(difference_type n) { current_index -= n; return self(); }
+
+            friend Derived operator+(const Derived& it, difference_type n) { Derived result = it; result += n; return result; }
+            friend Derived operator+(difference_type n, const Derived& it) { return it + n; }
+            friend Derived operator-(const Derived& it, difference_type n) { Derived result = it; result -= n; return result; }
+
+            friend difference_type operator-(const IteratorBase& a, const IteratorBase& b) {
+                return static_cast<difference_type>(a.current_index) - static_cast<difference_type>(b.current_index);
+            }
+
+            friend bool operator==(const IteratorBase& a, const IteratorBase& b) { 
+                return a.owner == b.owner && a.current_index == b.current_index; 
             }
-            bool operator!=(const AscendingIterator& other) const { return !(*this == other); }
+            friend bool operator!=(const IteratorBase& a, const IteratorBase& b) { return !(a == b); }
+            friend bool operator<(const IteratorBase& a, const IteratorBase& b) { return a.current_index < b.current_index; }
+            friend bool operator>(const IteratorBase& a, const IteratorBase& b) { return b < a; }
+            friend bool operator<=(const IteratorBase& a, const IteratorBase& b) { return !(b < a); }
+            friend bool operator>=(const IteratorBase& a, const IteratorBase& b) { return !(a < b); }
         };
 
         /**
-         * DescendingIterator - sorts elements from largest to smallest
-         * Example: [7,15,6,1,2] -> 15,7,6,2,1
+         * AscendingIterator - sorts elements from smallest to largest
+         * Example: [7,15,6,1,2] -> 1,2,6,7,15
          */
-        class DescendingIterator {
+        class AscendingIterator : public IteratorBase<AscendingIterator> {
         private:
-            std::vector<T> sorted_elements;
-            size_t current_index;
-            const MyContainer<T>* owner;
+            LazySortedIndex* sorted;  // Owned by the container, null for end iterators
 
         public:
-            DescendingIterator(const std::vector<T>& original_elements, size_t index, const MyContainer<T>* container_owner) 
-                : sorted_elements(original_elements), current_index(index), owner(container_owner) {
-                std::sort(sorted_elements.rbegin(), sorted_elements.rend());
-            }
+            AscendingIterator() : sorted(nullptr) {}
+
+            AscendingIterator(LazySortedIndex& sorted_index, size_t index, const MyContainer* container_owner) 
+                : IteratorBase<AscendingIterator>(index, container_owner), sorted(&sorted_index) {}
+
+            /**
+             * End iterator constructor - touches no index, so it costs nothing to create
+             */
+            AscendingIterator(size_t index, const MyContainer* container_owner) 
+                : IteratorBase<AscendingIterator>(index, container_owner), sorted(nullptr) {}
 
             /**
              * Dereference operator
              * @return Reference to the current element
              * @throws std::out_of_range if iterator is out of bounds
              */
-            const T& operator*() const { 
-                if (current_index >= sorted_elements.size()) {
+            const_reference operator*() const { 
+                this->check_valid();
+                if (this->current_index >= this->owner->size()) {
                     throw std::out_of_range("Iterator out of bounds");
                 }
-                return sorted_elements[current_index]; 
+                // An end iterator reached by stepping backwards uses the owner's current index
+                auto& index = sorted ? *sorted : this->owner->get_sorted_index();
+                return this->owner->elements[index.at(this->current_index, this->owner->elements, this->owner->index_mutex)]; 
             }
+        };
+
+        /**
+         * DescendingIterator - sorts elements from largest to smallest
+         * Example: [7,15,6,1,2] -> 15,7,6,2,1
+         */
+        class DescendingIterator : public IteratorBase<DescendingIterator> {
+        private:
+            LazySortedIndex* sorted;  // Owned by the container, null for end iterators
+
+        public:
+            DescendingIterator() : sorted(nullptr) {}
+
+            DescendingIterator(LazySortedIndex& sorted_index, size_t index, const MyContainer* container_owner) 
+                : IteratorBase<DescendingIterator>(index, container_owner), sorted(&sorted_index) {}
 
             /**
-             * Pre-increment operator
-             * @return Reference to this iterator after incrementing
+             * End iterator constructor - touches no index, so it costs nothing to create
              */
-            DescendingIterator& operator++() { ++current_index; return *this; }
-            
+            DescendingIterator(size_t index, const MyContainer* container_owner) 
+                : IteratorBase<DescendingIterator>(index, container_owner), sorted(nullptr) {}
+
             /**
-             * Post-increment operator
-             * @return Copy of iterator before incrementing
+             * Dereference operator
+             * @return Reference to the current element
+             * @throws std::out_of_range if iterator is out of bounds
              */
-            DescendingIterator operator++(int) {
-                DescendingIterator temp = *this;
-                ++current_index;
-                return temp;
-            }
-            
-            bool operator==(const DescendingIterator& other) const { 
-                return owner == other.owner && current_index == other.current_index; 
+            const_reference operator*() const { 
+                this->check_valid();
+                const Storage& elements = this->owner->elements;
+                size_t count = this->owner->size();
+                if (this->current_index >= count) {
+                    throw std::out_of_range("Iterator out of bounds");
+                }
+                // Descending order is the ascending index read back to front
+                auto& index = sorted ? *sorted : this->owner->get_sorted_index();
+                return elements[index.at(count - 1 - this->current_index, elements, this->owner->index_mutex)]; 
             }
-            bool operator!=(const DescendingIterator& other) const { return !(*this == other); }
         };
 
         /**
@@ -232,174 +1626,130 @@ namespace ex4 {
          * Example: [7,15,6,1,2] -> 1,15,2,7,6
          * Pattern: smallest, largest, 2nd smallest, 2nd largest, middle, etc.
          */
-        class SideCrossIterator {
+        class SideCrossIterator : public IteratorBase<SideCrossIterator> {
         private:
-            std::vector<T> cross_ordered_elements;
-            size_t current_index;
-            const MyContainer<T>* owner;
+            LazySortedIndex* sorted;  // Owned by the container, null for end iterators
 
         public:
-            SideCrossIterator(const std::vector<T>& original_elements, size_t index, const MyContainer<T>* container_owner) 
-                : current_index(index), owner(container_owner) {
-                
-                // Handle empty container case
-                if (original_elements.empty()) {
-                    return;
-                }
-                
-                std::vector<T> sorted_elements = original_elements;
-                std::sort(sorted_elements.begin(), sorted_elements.end());
-                
-                cross_ordered_elements.reserve(sorted_elements.size());
-                
-                size_t left = 0;
-                size_t right = sorted_elements.size() - 1;
-                bool take_from_left = true;
-                
-                while (left <= right) {
-                    if (take_from_left) {
-                        cross_ordered_elements.push_back(sorted_elements[left++]);
-                    } else {
-                        cross_ordered_elements.push_back(sorted_elements[right--]);
-                    }
-                    take_from_left = !take_from_left;
-                }
-            }
+            SideCrossIterator() : sorted(nullptr) {}
+
+            SideCrossIterator(LazySortedIndex& sorted_index, size_t index, const MyContainer* container_owner) 
+                : IteratorBase<SideCrossIterator>(index, container_owner), sorted(&sorted_index) {}
+
+            /**
+             * End iterator constructor - touches no index, so it costs nothing to create
+             */
+            SideCrossIterator(size_t index, const MyContainer* container_owner) 
+                : IteratorBase<SideCrossIterator>(index, container_owner), sorted(nullptr) {}
 
             /**
              * Dereference operator
              * @return Reference to the current element
              * @throws std::out_of_range if iterator is out of bounds
              */
-            const T& operator*() const { 
-                if (current_index >= cross_ordered_elements.size()) {
+            const_reference operator*() const { 
+                this->check_valid();
+                const Storage& elements = this->owner->elements;
+                size_t count = this->owner->size();
+                if (this->current_index >= count) {
                     throw std::out_of_range("Iterator out of bounds");
                 }
-                return cross_ordered_elements[current_index]; 
-            }
-
-            /**
-             * Pre-increment operator
-             * @return Reference to this iterator after incrementing
-             */
-            SideCrossIterator& operator++() { ++current_index; return *this; }
-            
-            /**
-             * Post-increment operator
-             * @return Copy of iterator before incrementing
-             */
-            SideCrossIterator operator++(int) {
-                SideCrossIterator temp = *this;
-                ++current_index;
-                return temp;
-            }
-            
-            bool operator==(const SideCrossIterator& other) const { 
-                return owner == other.owner && current_index == other.current_index; 
+                // An end iterator reached by stepping backwards uses the owner's current index
+                auto& index = sorted ? *sorted : this->owner->get_sorted_index();
+                return elements[index.at(detail::side_cross_rank(this->current_index, count), elements, this->owner->index_mutex)]; 
             }
-            bool operator!=(const SideCrossIterator& other) const { return !(*this == other); }
         };
 
         /**
          * ReverseIterator - iterates in reverse insertion order
          * Example: [7,15,6,1,2] -> 2,1,6,15,7
-         * Simply reverses the original order without sorting
+         * A thin view over the container storage read back to front - nothing is copied or sorted
+         * Dead elements are skipped by mapping ranks through the owner's tombstones
          */
-        class ReverseIterator {
+        class ReverseIterator : public IteratorBase<ReverseIterator> {
         private:
-            std::vector<T> reversed_elements;
-            size_t current_index;
-            const MyContainer<T>* owner;
+            const T* last;  // One past the last stored element - rank 0 is last[-1] (null for non-contiguous storage)
+            size_t count;   // Live elements
+            bool sparse;    // The owner has tombstones
+            [[no_unique_address]] mutable typename detail::scan_cursor<Storage>::type cursor;  // Decode state for non-contiguous storage
 
         public:
-            ReverseIterator(const std::vector<T>& original_elements, size_t index, const MyContainer<T>* container_owner) 
-                : reversed_elements(original_elements), current_index(index), owner(container_owner) {
-                std::reverse(reversed_elements.begin(), reversed_elements.end());
-            }
+            ReverseIterator() : last(nullptr), count(0), sparse(false) {}
+
+            ReverseIterator(size_t index, const MyContainer* container_owner) 
+                : IteratorBase<ReverseIterator>(index, container_owner), 
+                  last(contiguous_data(container_owner->elements, container_owner->elements.size())), 
+                  count(container_owner->size()), sparse(container_owner->tombstones.count() > 0) {}
 
             /**
              * Dereference operator
              * @return Reference to the current element
              * @throws std::out_of_range if iterator is out of bounds
              */
-            const T& operator*() const { 
-                if (current_index >= reversed_elements.size()) {
+            const_reference operator*() const { 
+                this->check_valid();
+                if (this->current_index >= count) {
                     throw std::out_of_range("Iterator out of bounds");
                 }
-                return reversed_elements[current_index]; 
-            }
-
-            /**
-             * Pre-increment operator
-             * @return Reference to this iterator after incrementing
-             */
-            ReverseIterator& operator++() { ++current_index; return *this; }
-            
-            /**
-             * Post-increment operator
-             * @return Copy of iterator before incrementing
-             */
-            ReverseIterator operator++(int) {
-                ReverseIterator temp = *this;
-                ++current_index;
-                return temp;
-            }
-            
-            bool operator==(const ReverseIterator& other) const { 
-                return owner == other.owner && current_index == other.current_index; 
+                if constexpr (detail::contiguous_storage<Storage>) {
+                    if (sparse) [[unlikely]] {
+                        return this->owner->elements[this->owner->physical(count - 1 - this->current_index)];
+                    }
+                    return *(last - 1 - this->current_index);
+                } else {
+                    // Only dense reads go through the cursor, so a value it holds needs no tombstone check
+                    if (cursor.holds(count - 1 - this->current_index) || !sparse) [[likely]] {
+                        return cursor.read(this->owner->elements, count - 1 - this->current_index);
+                    }
+                    return this->owner->elements[this->owner->physical(count - 1 - this->current_index)];
+                }
             }
-            bool operator!=(const ReverseIterator& other) const { return !(*this == other); }
         };
 
         /**
          * OrderIterator - iterates in natural insertion order
          * Example: [7,15,6,1,2] -> 7,15,6,1,2
-         * No modifications - preserves original order
+         * A thin view over the container storage - nothing is copied
+         * Dead elements are skipped by mapping ranks through the owner's tombstones
          */
-        class OrderIterator {
+        class OrderIterator : public IteratorBase<OrderIterator> {
         private:
-            std::vector<T> original_elements;
-            size_t current_index;
-            const MyContainer<T>* owner;
+            const T* first;  // The owner's contiguous storage (null for non-contiguous storage)
+            size_t count;    // Live elements
+            bool sparse;     // The owner has tombstones
+            [[no_unique_address]] mutable typename detail::scan_cursor<Storage>::type cursor;  // Decode state for non-contiguous storage
 
         public:
-            OrderIterator(const std::vector<T>& original_elements, size_t index, const MyContainer<T>* container_owner) 
-                : original_elements(original_elements), current_index(index), owner(container_owner) {
-                // No modifications - keep original order
-            }
+            OrderIterator() : first(nullptr), count(0), sparse(false) {}
+
+            OrderIterator(size_t index, const MyContainer* container_owner) 
+                : IteratorBase<OrderIterator>(index, container_owner), 
+                  first(contiguous_data(container_owner->elements)), 
+                  count(container_owner->size()), sparse(container_owner->tombstones.count() > 0) {}
 
             /**
              * Dereference operator
              * @return Reference to the current element
              * @throws std::out_of_range if iterator is out of bounds
              */
-            const T& operator*() const { 
-                if (current_index >= original_elements.size()) {
+            const_reference operator*() const { 
+                this->check_valid();
+                if (this->current_index >= count) {
                     throw std::out_of_range("Iterator out of bounds");
                 }
-                return original_elements[current_index]; 
-            }
-
-            /**
-             * Pre-increment operator
-             * @return Reference to this iterator after incrementing
-             */
-            OrderIterator& operator++() { ++current_index; return *this; }
-            
-            /**
-             * Post-increment operator
-             * @return Copy of iterator before incrementing
-             */
-            OrderIterator operator++(int) {
-                OrderIterator temp = *this;
-                ++current_index;
-                return temp;
-            }
-            
-            bool operator==(const OrderIterator& other) const { 
-                return owner == other.owner && current_index == other.current_index; 
+                if constexpr (detail::contiguous_storage<Storage>) {
+                    if (sparse) [[unlikely]] {
+                        return this->owner->elements[this->owner->physical(this->current_index)];
+                    }
+                    return first[this->current_index];
+                } else {
+                    // Only dense reads go through the cursor, so a value it holds needs no tombstone check
+                    if (cursor.holds(this->current_index) || !sparse) [[likely]] {
+                        return cursor.read(this->owner->elements, this->current_index);
+                    }
+                    return this->owner->elements[this->owner->physical(this->current_index)];
+                }
             }
-            bool operator!=(const OrderIterator& other) const { return !(*this == other); }
         };
 
         /**
@@ -407,101 +1757,89 @@ namespace ex4 {
          * Example: [7,15,6,1,2] -> 6,15,1,7,2
          * Pattern: middle, left1, right1, left2, right2, etc.
          */
-        class MiddleOutIterator {
-        private:
-            std::vector<T> middle_out_elements;
-            size_t current_index;
-            const MyContainer<T>* owner;
-
+        class MiddleOutIterator : public IteratorBase<MiddleOutIterator> {
         public:
-            MiddleOutIterator(const std::vector<T>& original_elements, size_t index, const MyContainer<T>* container_owner) 
-                : current_index(index), owner(container_owner) {
-                
-                if (original_elements.empty()) return;
-                
-                size_t size = original_elements.size();
-                size_t middle = size / 2;
-                
-                middle_out_elements.reserve(size);
-                
-                // Add middle element first
-                middle_out_elements.push_back(original_elements[middle]);
-                
-                // Add elements at increasing distances from middle
-                for (size_t distance = 1; distance < size; ++distance) {
-                    // Try left side
-                    if (middle >= distance) {
-                        middle_out_elements.push_back(original_elements[middle - distance]);
-                    }
-                    // Try right side
-                    if (middle + distance < size) {
-                        middle_out_elements.push_back(original_elements[middle + distance]);
-                    }
-                }
-            }
+            MiddleOutIterator() = default;
+
+            MiddleOutIterator(size_t index, const MyContainer* container_owner) 
+                : IteratorBase<MiddleOutIterator>(index, container_owner) {}
 
             /**
              * Dereference operator
              * @return Reference to the current element
              * @throws std::out_of_range if iterator is out of bounds
              */
-            const T& operator*() const { 
-                if (current_index >= middle_out_elements.size()) {
+            const_reference operator*() const { 
+                this->check_valid();
+                size_t count = this->owner->size();
+                if (this->current_index >= count) {
                     throw std::out_of_range("Iterator out of bounds");
                 }
-                return middle_out_elements[current_index]; 
-            }
-
-            /**
-             * Pre-increment operator
-             * @return Reference to this iterator after incrementing
-             */
-            MiddleOutIterator& operator++() { ++current_index; return *this; }
-            
-            /**
-             * Post-increment operator
-             * @return Copy of iterator before incrementing
-             */
-            MiddleOutIterator operator++(int) {
-                MiddleOutIterator temp = *this;
-                ++current_index;
-                return temp;
-            }
-            
-            bool operator==(const MiddleOutIterator& other) const { 
-                return owner == other.owner && current_index == other.current_index; 
+                return this->owner->elements[this->owner->physical(detail::middle_out_position(this->current_index, count))]; 
             }
-            bool operator!=(const MiddleOutIterator& other) const { return !(*this == other); }
         };
 
         // ================== ITERATOR ACCESS FUNCTIONS ==================
+
+        /**
+         * Finish sorting the cached index now instead of on demand
+         * Ordered traversals of the unchanged container then only read the index and never take the
+         * lazy-sort lock - call this before a parallel or shared traversal, e.g.
+         * std::for_each(std::execution::par, c.begin_ascending_order(), c.end_ascending_order(), f)
+         */
+        void sort_now() const {
+            LazySortedIndex& index = get_sorted_index();
+            std::lock_guard<std::mutex> guard(index_mutex);
+            index.settle_all(elements);
+        }
         
         // AscendingOrder iteration
-        AscendingIterator begin_ascending_order() const { return AscendingIterator(elements, 0, this); }
-        AscendingIterator end_ascending_order() const { return AscendingIterator(elements, elements.size(), this); }
+        AscendingIterator begin_ascending_order() const { return AscendingIterator(get_sorted_index(), 0, this); }
+        AscendingIterator end_ascending_order() const { return AscendingIterator(size(), this); }
 
         // DescendingOrder iteration
-        DescendingIterator begin_descending_order() const { return DescendingIterator(elements, 0, this); }
-        DescendingIterator end_descending_order() const { return DescendingIterator(elements, elements.size(), this); }
+        DescendingIterator begin_descending_order() const { return DescendingIterator(get_sorted_index(), 0, this); }
+        DescendingIterator end_descending_order() const { return DescendingIterator(size(), this); }
 
         // SideCrossOrder iteration
-        SideCrossIterator begin_side_cross_order() const { return SideCrossIterator(elements, 0, this); }
-        SideCrossIterator end_side_cross_order() const { return SideCrossIterator(elements, elements.size(), this); }
+        SideCrossIterator begin_side_cross_order() const { return SideCrossIterator(get_sorted_index(), 0, this); }
+        SideCrossIterator end_side_cross_order() const { return SideCrossIterator(size(), this); }
 
         // ReverseOrder iteration
-        ReverseIterator begin_reverse_order() const { return ReverseIterator(elements, 0, this); }
-        ReverseIterator end_reverse_order() const { return ReverseIterator(elements, elements.size(), this); }
+        ReverseIterator begin_reverse_order() const { return ReverseIterator(0, this); }
+        ReverseIterator end_reverse_order() const { return ReverseIterator(size(), this); }
 
         // Natural order iteration
-        OrderIterator begin_order() const { return OrderIterator(elements, 0, this); }
-        OrderIterator end_order() const { return OrderIterator(elements, elements.size(), this); }
+        OrderIterator begin_order() const { return OrderIterator(0, this); }
+        OrderIterator end_order() const { return OrderIterator(size(), this); }
 
         // MiddleOutOrder iteration
-        MiddleOutIterator begin_middle_out_order() const { return MiddleOutIterator(elements, 0, this); }
-        MiddleOutIterator end_middle_out_order() const { return MiddleOutIterator(elements, elements.size(), this); }
+        MiddleOutIterator begin_middle_out_order() const { return MiddleOutIterator(0, this); }
+        MiddleOutIterator end_middle_out_order() const { return MiddleOutIterator(size(), this); }
+
+        // ================== RANGE VIEWS ==================
+
+        // Each view is a sized random-access std::ranges::subrange over the matching begin_*/end_* pair,
+        // so it composes lazily with std::views (e.g. container.ascending() | std::views::take(k)
+        // only sorts as far as the first k ranks)
+        std::ranges::subrange<AscendingIterator> ascending() const { return {begin_ascending_order(), end_ascending_order()}; }
+        std::ranges::subrange<DescendingIterator> descending() const { return {begin_descending_order(), end_descending_order()}; }
+        std::ranges::subrange<SideCrossIterator> side_cross() const { return {begin_side_cross_order(), end_side_cross_order()}; }
+        std::ranges::subrange<ReverseIterator> reverse() const { return {begin_reverse_order(), end_reverse_order()}; }
+        std::ranges::subrange<OrderIterator> order() const { return {begin_order(), end_order()}; }
+        std::ranges::subrange<MiddleOutIterator> middle_out() const { return {begin_middle_out_order(), end_middle_out_order()}; }
 
     }; // End of MyContainer class
 
+    namespace pmr {
+
+        /**
+         * MyContainer whose elements and sorted index allocate from a std::pmr::memory_resource
+         */
+        template<typename T = int> using MyContainer = ex4::MyContainer<T, std::pmr::polymorphic_allocator<T>>;
+
+    } // End of pmr namespace
+
 } // End of ex4 namespace
 
 #endif // MYCONTAINER_HPP
\ No newline at end of file
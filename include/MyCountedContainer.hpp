@@ -0,0 +1,249 @@
+// Nitzanwa@gmail.com
+
+#ifndef MYCOUNTEDCONTAINER_HPP
+#define MYCOUNTEDCONTAINER_HPP
+
+#include <iostream>
+#include <map>
+#include <iterator>
+#include <ranges>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <cstddef>
+#include <initializer_list>
+
+namespace ex4 {
+
+    /**
+     * MyCountedContainer - count-compressed counterpart of MyContainer for duplicate-heavy data
+     *
+     * Keeps each distinct value once, with its multiplicity, in a std::map. add() and remove() are
+     * O(log d) for d distinct values, memory scales with d rather than with the number of adds, and
+     * the map is always sorted, so the ascending, descending and side-cross iterators simply expand
+     * runs as they advance - no sort at all.
+     *
+     * Insertion order is not recorded (that is what makes the compression possible), so the
+     * reverse, order and middle-out iterations of MyContainer are not offered.
+     *
+     * Template parameter T defaults to int but can be any type with operator< defined
+     */
+    template<typename T = int> class MyCountedContainer {
+
+    public:
+        using value_type = T;
+
+    private:
+        using Runs = std::map<T, size_t>;  // Distinct value -> multiplicity
+
+        Runs runs;
+        size_t total = 0;
+
+        /**
+         * Position inside the expanded sorted sequence: a run plus how many of its copies were consumed
+         */
+        template<typename RunIterator> struct RunCursor {
+            RunIterator run{};
+            size_t used = 0;
+
+            void advance() {
+                if (++used == run->second) {
+                    ++run;
+                    used = 0;
+                }
+            }
+        };
+
+    public:
+        // ================== CONSTRUCTORS ==================
+
+        MyCountedContainer() = default;
+
+        /**
+         * Initializer list constructor
+         * @param values Initial elements
+         */
+        MyCountedContainer(std::initializer_list<T> values) {
+            for (const T& value : values) {
+                add(value);
+            }
+        }
+
+        // ================== BASIC OPERATIONS ==================
+
+        /**
+         * Add copies of an element
+         * @param element The element to add
+         * @param copies Number of copies to add
+         */
+        void add(const T& element, size_t copies = 1) {
+            if (copies == 0) return;
+            runs[element] += copies;
+            total += copies;
+        }
+
+        /**
+         * Remove all occurrences of an element from the container
+         * @param element The element to remove
+         * @throws std::runtime_error if element is not found in container
+         */
+        void remove(const T& element) {
+            auto it = runs.find(element);
+            if (it == runs.end()) {
+                throw std::runtime_error("Element was not found in the container");
+            }
+            total -= it->second;
+            runs.erase(it);
+        }
+
+        /**
+         * Get the multiplicity of an element
+         * @param element The element to look up
+         * @return Number of copies held, 0 if absent
+         */
+        size_t count(const T& element) const {
+            auto it = runs.find(element);
+            return it == runs.end() ? 0 : it->second;
+        }
+
+        size_t size() const { return total; }
+        bool empty() const { return total == 0; }
+
+        /**
+         * Get the number of distinct elements
+         * @return Number of runs stored
+         */
+        size_t distinct_size() const { return runs.size(); }
+
+        /**
+         * Output operator - prints the elements in ascending order, in the same format as MyContainer
+         */
+        friend std::ostream& operator<<(std::ostream& os, const MyCountedContainer& container) {
+            os << "[";
+            size_t printed = 0;
+            for (const auto& [value, copies] : container.runs) {
+                for (size_t i = 0; i < copies; ++i) {
+                    if constexpr (std::is_same_v<T, std::string>) {
+                        os << "\"" << value << "\"";
+                    } else {
+                        os << value;
+                    }
+                    if (++printed < container.total) {
+                        os << ", ";
+                    }
+                }
+            }
+            os << "]";
+            return os;
+        }
+
+        // ================== ITERATOR CLASSES ==================
+
+        /**
+         * Forward iterator that expands the runs of a map iterator type (ascending or descending)
+         * Equality compares the rank, so begin/end pairs are cheap to build
+         */
+        template<typename RunIterator> class RunIteratorBase {
+            RunCursor<RunIterator> cursor;
+            RunIterator last_run{};
+            size_t current_index = 0;
+
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const T*;
+            using reference = const T&;
+
+            RunIteratorBase() = default;
+            RunIteratorBase(RunIterator first_run, RunIterator end_run, size_t index) 
+                : cursor{first_run, 0}, last_run(end_run), current_index(index) {}
+
+            /**
+             * @throws std::out_of_range if the iterator is at the end
+             */
+            const T& operator*() const {
+                if (cursor.run == last_run) {
+                    throw std::out_of_range("Iterator out of bounds");
+                }
+                return cursor.run->first;
+            }
+            const T* operator->() const { return &**this; }
+
+            RunIteratorBase& operator++() { cursor.advance(); ++current_index; return *this; }
+            RunIteratorBase operator++(int) { RunIteratorBase temp = *this; ++*this; return temp; }
+
+            friend bool operator==(const RunIteratorBase& a, const RunIteratorBase& b) { return a.current_index == b.current_index; }
+        };
+
+        using AscendingIterator = RunIteratorBase<typename Runs::const_iterator>;
+        using DescendingIterator = RunIteratorBase<typename Runs::const_reverse_iterator>;
+
+        /**
+         * SideCrossIterator - alternates between the smallest and largest remaining elements
+         * Holds a front cursor and a back cursor over the runs; each step advances the one it read from
+         */
+        class SideCrossIterator {
+            RunCursor<typename Runs::const_iterator> front;
+            RunCursor<typename Runs::const_reverse_iterator> back;
+            size_t current_index = 0;
+            size_t count = 0;
+
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const T*;
+            using reference = const T&;
+
+            SideCrossIterator() = default;
+            SideCrossIterator(const MyCountedContainer* owner, size_t index)
+                : front{owner->runs.cbegin(), 0}, back{owner->runs.crbegin(), 0}, current_index(index), count(owner->total) {}
+
+            /**
+             * @throws std::out_of_range if the iterator is at the end
+             */
+            const T& operator*() const {
+                if (current_index >= count) {
+                    throw std::out_of_range("Iterator out of bounds");
+                }
+                return (current_index % 2 == 0) ? front.run->first : back.run->first;
+            }
+            const T* operator->() const { return &**this; }
+
+            SideCrossIterator& operator++() {
+                if (current_index % 2 == 0) {
+                    front.advance();
+                } else {
+                    back.advance();
+                }
+                ++current_index;
+                return *this;
+            }
+            SideCrossIterator operator++(int) { SideCrossIterator temp = *this; ++*this; return temp; }
+
+            friend bool operator==(const SideCrossIterator& a, const SideCrossIterator& b) { return a.current_index == b.current_index; }
+        };
+
+        // ================== ITERATOR ACCESS FUNCTIONS ==================
+
+        AscendingIterator begin_ascending_order() const { return AscendingIterator(runs.cbegin(), runs.cend(), 0); }
+        AscendingIterator end_ascending_order() const { return AscendingIterator(runs.cend(), runs.cend(), total); }
+
+        DescendingIterator begin_descending_order() const { return DescendingIterator(runs.crbegin(), runs.crend(), 0); }
+        DescendingIterator end_descending_order() const { return DescendingIterator(runs.crend(), runs.crend(), total); }
+
+        SideCrossIterator begin_side_cross_order() const { return SideCrossIterator(this, 0); }
+        SideCrossIterator end_side_cross_order() const { return SideCrossIterator(this, total); }
+
+        // ================== RANGE VIEWS ==================
+
+        std::ranges::subrange<AscendingIterator> ascending() const { return {begin_ascending_order(), end_ascending_order()}; }
+        std::ranges::subrange<DescendingIterator> descending() const { return {begin_descending_order(), end_descending_order()}; }
+        std::ranges::subrange<SideCrossIterator> side_cross() const { return {begin_side_cross_order(), end_side_cross_order()}; }
+
+    }; // End of MyCountedContainer class
+
+} // End of ex4 namespace
+
+#endif // MYCOUNTEDCONTAINER_HPP
@@ -0,0 +1,206 @@
+// Nitzanwa@gmail.com
+
+#ifndef MYSTATICCONTAINER_HPP
+#define MYSTATICCONTAINER_HPP
+
+#include "MyContainer.hpp"
+#include <array>
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <ranges>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <cstddef>
+#include <initializer_list>
+
+namespace ex4 {
+
+    /**
+     * MyStaticContainer - fixed-capacity counterpart of MyContainer that works in constant expressions
+     *
+     * Holds at most N elements in a std::array and keeps a sorted permutation up to date on every add()
+     * and remove(), so all six iteration orders are plain index lookups. Every operation is constexpr:
+     * a table can be built, ordered and checked with static_assert without any runtime cost.
+     *
+     * Template parameter T must be a literal, default-constructible type with operator< defined
+     * Template parameter N is the maximum number of elements
+     */
+    template<typename T, size_t N> class MyStaticContainer {
+
+    public:
+        using value_type = T;
+
+    private:
+        std::array<T, N> elements{};       // elements[0, count) in insertion order
+        std::array<size_t, N> sorted{};    // sorted[rank] - index into elements, ascending
+        size_t count = 0;
+
+        enum class Order { Ascending, Descending, SideCross, Reverse, Insertion, MiddleOut };
+
+        /**
+         * Position in elements of the element visited at rank in the given order
+         */
+        template<Order Kind> constexpr size_t position(size_t rank) const {
+            if constexpr (Kind == Order::Ascending) return sorted[rank];
+            else if constexpr (Kind == Order::Descending) return sorted[count - 1 - rank];
+            else if constexpr (Kind == Order::SideCross) return sorted[detail::side_cross_rank(rank, count)];
+            else if constexpr (Kind == Order::Reverse) return count - 1 - rank;
+            else if constexpr (Kind == Order::Insertion) return rank;
+            else return detail::middle_out_position(rank, count);
+        }
+
+        /**
+         * Rebuild the sorted permutation from scratch (stable insertion sort - N is small and known at compile time)
+         */
+        constexpr void rebuild_sorted() {
+            for (size_t i = 0; i < count; ++i) {
+                size_t j = i;
+                while (j > 0 && elements[i] < elements[sorted[j - 1]]) {
+                    sorted[j] = sorted[j - 1];
+                    --j;
+                }
+                sorted[j] = i;
+            }
+        }
+
+    public:
+        // ================== CONSTRUCTORS ==================
+
+        constexpr MyStaticContainer() = default;
+
+        /**
+         * Initializer list constructor
+         * @param values Initial elements, in insertion order
+         * @throws std::length_error if values holds more than N elements
+         */
+        constexpr MyStaticContainer(std::initializer_list<T> values) {
+            for (const T& value : values) {
+                add(value);
+            }
+        }
+
+        // ================== BASIC OPERATIONS ==================
+
+        /**
+         * Add an element, inserting its position into the sorted permutation (after any equal elements)
+         * @param element The element to add
+         * @throws std::length_error if the container already holds N elements
+         */
+        constexpr void add(const T& element) {
+            if (count == N) {
+                throw std::length_error("MyStaticContainer is full");
+            }
+            elements[count] = element;
+
+            size_t rank = static_cast<size_t>(std::upper_bound(sorted.begin(), sorted.begin() + count, count,
+                [this](size_t lhs, size_t rhs) { return elements[lhs] < elements[rhs]; }) - sorted.begin());
+            std::copy_backward(sorted.begin() + rank, sorted.begin() + count, sorted.begin() + count + 1);
+            sorted[rank] = count;
+            ++count;
+        }
+
+        /**
+         * Remove all occurrences of an element from the container
+         * @param element The element to remove
+         * @throws std::runtime_error if element is not found in container
+         */
+        constexpr void remove(const T& element) {
+            size_t kept = 0;
+            for (size_t i = 0; i < count; ++i) {
+                if (!(elements[i] == element)) {
+                    elements[kept++] = elements[i];
+                }
+            }
+            if (kept == count) {
+                throw std::runtime_error("Element was not found in the container");
+            }
+            count = kept;
+            rebuild_sorted();
+        }
+
+        constexpr size_t size() const { return count; }
+        constexpr bool empty() const { return count == 0; }
+        static constexpr size_t capacity() { return N; }
+
+        /**
+         * Output operator for printing the container, in the same format as MyContainer
+         */
+        friend std::ostream& operator<<(std::ostream& os, const MyStaticContainer& container) {
+            os << "[";
+            for (size_t i = 0; i < container.count; ++i) {
+                if constexpr (std::is_same_v<T, std::string>) {
+                    os << "\"" << container.elements[i] << "\"";
+                } else {
+                    os << container.elements[i];
+                }
+                if (i < container.count - 1) {
+                    os << ", ";
+                }
+            }
+            os << "]";
+            return os;
+        }
+
+        // ================== ITERATOR CLASS ==================
+
+        /**
+         * Element access of the order iterators - maps a rank in order Kind to a position in constant time
+         * @throws std::out_of_range if the rank is at or past the end
+         */
+        template<Order Kind> struct OrderAccess {
+            constexpr const T& operator()(const MyStaticContainer& container, size_t rank) const {
+                if (rank >= container.count) {
+                    throw std::out_of_range("Iterator out of bounds");
+                }
+                return container.elements[container.template position<Kind>(rank)];
+            }
+        };
+
+        /**
+         * Random access iterator over one of the six orders - holds the owner and a rank
+         */
+        template<Order Kind> using Iterator = detail::IndexIterator<const MyStaticContainer, const T&, OrderAccess<Kind>>;
+
+        using AscendingIterator = Iterator<Order::Ascending>;
+        using DescendingIterator = Iterator<Order::Descending>;
+        using SideCrossIterator = Iterator<Order::SideCross>;
+        using ReverseIterator = Iterator<Order::Reverse>;
+        using OrderIterator = Iterator<Order::Insertion>;
+        using MiddleOutIterator = Iterator<Order::MiddleOut>;
+
+        // ================== ITERATOR ACCESS METHODS ==================
+
+        constexpr AscendingIterator begin_ascending_order() const { return {this, 0}; }
+        constexpr AscendingIterator end_ascending_order() const { return {this, count}; }
+
+        constexpr DescendingIterator begin_descending_order() const { return {this, 0}; }
+        constexpr DescendingIterator end_descending_order() const { return {this, count}; }
+
+        constexpr SideCrossIterator begin_side_cross_order() const { return {this, 0}; }
+        constexpr SideCrossIterator end_side_cross_order() const { return {this, count}; }
+
+        constexpr ReverseIterator begin_reverse_order() const { return {this, 0}; }
+        constexpr ReverseIterator end_reverse_order() const { return {this, count}; }
+
+        constexpr OrderIterator begin_order() const { return {this, 0}; }
+        constexpr OrderIterator end_order() const { return {this, count}; }
+
+        constexpr MiddleOutIterator begin_middle_out_order() const { return {this, 0}; }
+        constexpr MiddleOutIterator end_middle_out_order() const { return {this, count}; }
+
+        // ================== RANGE VIEWS ==================
+
+        constexpr std::ranges::subrange<AscendingIterator> ascending() const { return {begin_ascending_order(), end_ascending_order()}; }
+        constexpr std::ranges::subrange<DescendingIterator> descending() const { return {begin_descending_order(), end_descending_order()}; }
+        constexpr std::ranges::subrange<SideCrossIterator> side_cross() const { return {begin_side_cross_order(), end_side_cross_order()}; }
+        constexpr std::ranges::subrange<ReverseIterator> reverse() const { return {begin_reverse_order(), end_reverse_order()}; }
+        constexpr std::ranges::subrange<OrderIterator> order() const { return {begin_order(), end_order()}; }
+        constexpr std::ranges::subrange<MiddleOutIterator> middle_out() const { return {begin_middle_out_order(), end_middle_out_order()}; }
+
+    }; // End of MyStaticContainer class
+
+} // End of ex4 namespace
+
+#endif // MYSTATICCONTAINER_HPP
@@ -0,0 +1,343 @@
+// Nitzanwa@gmail.com
+
+#ifndef PACKEDSTORAGE_HPP
+#define PACKEDSTORAGE_HPP
+
+#include "MyContainer.hpp"
+#include <memory>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ex4 {
+
+    /**
+     * PackedStorage - compressed storage for integers that use only a few significant bits
+     *
+     * Values are packed in blocks of 128 using frame-of-reference coding: each block stores its
+     * minimum and the offsets from it at the bit width of the block's range, so 12-bit data costs
+     * about 12 bits per value instead of 32. Appends collect in a small unpacked tail that is packed
+     * once it holds a full block.
+     *
+     * Elements are read back by value. operator[] extracts one value with a couple of shifts and
+     * keeps no state, so concurrent reads are safe. Sorting decodes the storage once up front
+     * (see MyContainer's LazySortedIndex) instead of extracting on every comparison.
+     * Scans go through a ScanCursor held by each iterator: once two reads in a row hit the same
+     * block (a scan in any direction) the cursor decodes the whole block into its own buffer with a
+     * fixed-length, branch-free loop, and the rest of the scan reads from there.
+     * Used as the Storage parameter of MyContainer (see PackedContainer below).
+     *
+     * Template parameter T must be an integral type
+     */
+    template<typename T, typename Allocator = std::allocator<T>> class PackedStorage {
+        static_assert(std::is_integral_v<T> && !std::is_same_v<T, bool>, "PackedStorage needs an integral T");
+
+        using Unsigned = std::make_unsigned_t<T>;
+        using AllocatorTraits = std::allocator_traits<Allocator>;
+
+        static constexpr size_t BLOCK_VALUES = 128;  // One 128-bit row holds one word per lane
+        static constexpr size_t NO_BLOCK = std::numeric_limits<size_t>::max();
+
+        // Blocks are laid out in lanes: value i of a block sits in lane i % LANES, at position
+        // i / LANES of that lane. A lane holds WORD_BITS values, so a block of width w is w rows of
+        // LANES words, and one value position decodes every lane with the same shifts - a single
+        // SIMD operation on a 128-bit register
+        static constexpr size_t WORD_BITS = std::numeric_limits<Unsigned>::digits;
+        static constexpr size_t LANES = BLOCK_VALUES / WORD_BITS;
+
+        struct Block {
+            T base;              // Smallest value in the block
+            std::uint8_t width;  // Bits per offset from base
+            size_t first_word;   // Offset of the block's first row in words
+        };
+
+        std::vector<Block, typename AllocatorTraits::template rebind_alloc<Block>> blocks;
+        std::vector<Unsigned, typename AllocatorTraits::template rebind_alloc<Unsigned>> words;  // Packed rows plus one zero pad row
+        std::array<T, BLOCK_VALUES> tail{};  // Values not packed yet
+        size_t tail_count = 0;
+
+        static constexpr Unsigned width_mask(unsigned width) {
+            return width == WORD_BITS ? static_cast<Unsigned>(~Unsigned{0}) : static_cast<Unsigned>((std::uint64_t{1} << width) - 1);
+        }
+
+        /**
+         * Read offset number slot of a block - branch-free, relies on the pad row after the last block
+         */
+        Unsigned extract(const Block& block, size_t slot) const {
+            size_t bit = slot / LANES * block.width;
+            const Unsigned* low = words.data() + block.first_word + bit / WORD_BITS * LANES + slot % LANES;
+            unsigned shift = static_cast<unsigned>(bit % WORD_BITS);
+            auto offset = static_cast<Unsigned>(low[0] >> shift);
+            auto high = static_cast<Unsigned>(static_cast<Unsigned>(low[LANES] << 1) << (WORD_BITS - 1 - shift));
+            return static_cast<Unsigned>(offset | high) & width_mask(block.width);
+        }
+
+        static T restore(T base, Unsigned offset) {
+            return static_cast<T>(static_cast<Unsigned>(static_cast<Unsigned>(base) + offset));
+        }
+
+        /**
+         * Decode value position Position of every lane of a block packed at Width bits - the shifts
+         * are constants and the lane loop is one vector operation
+         */
+        template<unsigned Width, size_t Position> static void decode_position(const Unsigned* rows, T base, T* out) {
+            constexpr size_t bit = Position * Width;
+            constexpr unsigned shift = static_cast<unsigned>(bit % WORD_BITS);
+            // Load the rows before storing anything - out may alias rows as far as the compiler knows
+            std::array<Unsigned, LANES> low;
+            std::array<Unsigned, LANES> high{};
+            std::copy_n(rows + bit / WORD_BITS * LANES, LANES, low.begin());
+            if constexpr (shift + Width > WORD_BITS) {
+                std::copy_n(rows + (bit / WORD_BITS + 1) * LANES, LANES, high.begin());
+            }
+            std::array<T, LANES> values;
+            for (size_t lane = 0; lane < LANES; ++lane) {
+                auto offset = static_cast<Unsigned>(low[lane] >> shift);
+                if constexpr (shift + Width > WORD_BITS) {
+                    offset |= static_cast<Unsigned>(high[lane] << (WORD_BITS - shift));
+                }
+                values[lane] = restore(base, offset & width_mask(Width));
+            }
+            std::copy_n(values.begin(), LANES, out + Position * LANES);
+        }
+
+        /**
+         * Decode a block packed at a width known at compile time - unrolled into straight-line,
+         * branch-free code over all positions
+         */
+        template<unsigned Width> static void decode_fixed(const Unsigned* rows, T base, T* out) {
+            [&]<size_t... Positions>(std::index_sequence<Positions...>) {
+                (decode_position<Width, Positions>(rows, base, out), ...);
+            }(std::make_index_sequence<WORD_BITS>{});
+        }
+
+        using Decoder = void (*)(const Unsigned*, T, T*);
+
+        // decoders[w] decodes a block of width w; a range of T never needs more bits than T has
+        static constexpr auto decoders = []<unsigned... Widths>(std::integer_sequence<unsigned, Widths...>) {
+            return std::array<Decoder, sizeof...(Widths)>{&decode_fixed<Widths>...};
+        }(std::make_integer_sequence<unsigned, WORD_BITS + 1>{});
+
+        /**
+         * Decode a whole block through the decoder for its width
+         * Out of line and pure (it only writes its result), so a scan loop that calls it keeps its
+         * validity checks hoisted instead of reloading them after every block
+         */
+        [[gnu::pure, gnu::noinline]] std::array<T, BLOCK_VALUES> decode_block(size_t index) const {
+            const Block& block = blocks[index];
+            std::array<T, BLOCK_VALUES> values;
+            decoders[block.width](words.data() + block.first_word, block.base, values.data());
+            return values;
+        }
+
+        /**
+         * Pack the full tail into a new block
+         */
+        void pack_tail() {
+            auto [low, high] = std::minmax_element(tail.begin(), tail.end());
+            T base = *low;
+            auto range = static_cast<Unsigned>(static_cast<Unsigned>(*high) - static_cast<Unsigned>(base));
+            unsigned width = static_cast<unsigned>(std::bit_width(range));
+
+            // Reuse the old pad row; a constant block (width 0) still gets one row so reads stay in bounds
+            size_t first_word = words.empty() ? 0 : words.size() - LANES;
+            words.resize(first_word + (std::max<size_t>(width, 1) + 1) * LANES, 0);
+            for (size_t slot = 0; slot < BLOCK_VALUES; ++slot) {
+                auto offset = static_cast<Unsigned>(static_cast<Unsigned>(tail[slot]) - static_cast<Unsigned>(base));
+                size_t bit = slot / LANES * width;
+                size_t word = first_word + bit / WORD_BITS * LANES + slot % LANES;
+                unsigned shift = static_cast<unsigned>(bit % WORD_BITS);
+                words[word] |= static_cast<Unsigned>(offset << shift);
+                if (shift + width > WORD_BITS) {
+                    words[word + LANES] |= static_cast<Unsigned>(offset >> (WORD_BITS - shift));
+                }
+            }
+            blocks.push_back(Block{base, static_cast<std::uint8_t>(width), first_word});
+            tail_count = 0;
+        }
+
+    public:
+        using value_type = T;
+        using allocator_type = Allocator;
+        using size_type = size_t;
+        using reference = T;
+        using const_reference = T;
+        using const_iterator = detail::IndexIterator<const PackedStorage, T>;
+        using iterator = const_iterator;
+
+        // ================== CONSTRUCTORS ==================
+
+        PackedStorage() = default;
+
+        explicit PackedStorage(const Allocator& alloc) : blocks(alloc), words(alloc) {}
+
+        PackedStorage(std::initializer_list<T> values, const Allocator& alloc = Allocator())
+            : PackedStorage(values.begin(), values.end(), alloc) {}
+
+        template<std::input_iterator InputIt>
+        PackedStorage(InputIt first, InputIt last, const Allocator& alloc = Allocator()) : PackedStorage(alloc) {
+            for (; first != last; ++first) {
+                push_back(static_cast<T>(*first));
+            }
+        }
+
+        PackedStorage(const PackedStorage& other) = default;
+
+        PackedStorage(const PackedStorage& other, const Allocator& alloc)
+            : blocks(other.blocks, alloc), words(other.words, alloc), tail(other.tail), tail_count(other.tail_count) {}
+
+        PackedStorage(PackedStorage&& other) noexcept
+            : blocks(std::move(other.blocks)), words(std::move(other.words)), tail(other.tail), tail_count(other.tail_count) {
+            other.clear();
+        }
+
+        PackedStorage& operator=(const PackedStorage& other) = default;
+
+        PackedStorage& operator=(PackedStorage&& other) {
+            if (this != &other) {
+                blocks = std::move(other.blocks);
+                words = std::move(other.words);
+                tail = other.tail;
+                tail_count = other.tail_count;
+                other.clear();
+            }
+            return *this;
+        }
+
+        /**
+         * ScanCursor - decode buffer of one iterator, for reads that walk the storage in order
+         * MyContainer's Order and Reverse iterators each hold one (see scan_cursor), so the buffer
+         * is never shared between threads. Iterators are invalidated by any modification, which
+         * keeps the buffer from outliving the blocks it was decoded from.
+         */
+        class ScanCursor {
+            size_t decoded_first = 0 - BLOCK_VALUES;  // Index of decoded[0], starting where no index reaches
+            size_t last_block = NO_BLOCK;
+            std::array<T, BLOCK_VALUES> decoded;
+
+        public:
+            /**
+             * Check whether index is in the decoded buffer
+             * One unsigned compare covers both ends of the buffer, in either scan direction
+             */
+            bool holds(size_t index) const { return index - decoded_first < BLOCK_VALUES; }
+
+            /**
+             * Read the value at index - from the buffer, or a single extraction
+             * A second read in the same block decodes the whole block for the reads that follow
+             */
+            T read(const PackedStorage& storage, size_t index) {
+                if (holds(index)) [[likely]] {
+                    return decoded[index - decoded_first];
+                }
+                size_t block = index / BLOCK_VALUES;
+                if (block == last_block && block < storage.blocks.size()) {
+                    // Decoded by value, so no call sees the iterator's address and the scan loop keeps it in registers
+                    decoded = storage.decode_block(block);
+                    decoded_first = block * BLOCK_VALUES;
+                    return decoded[index % BLOCK_VALUES];
+                }
+                last_block = block;
+                return storage[index];
+            }
+        };
+
+        using scan_cursor = ScanCursor;
+
+        // ================== ACCESS ==================
+
+        /**
+         * Read the value at index - from the tail, or a single extraction
+         * Keeps no state, so any number of threads may read at once
+         */
+        T operator[](size_t index) const {
+            size_t block = index / BLOCK_VALUES;
+            size_t slot = index % BLOCK_VALUES;
+            if (block == blocks.size()) {
+                return tail[slot];
+            }
+            return restore(blocks[block].base, extract(blocks[block], slot));
+        }
+
+        const_iterator begin() const { return const_iterator(this, 0); }
+        const_iterator end() const { return const_iterator(this, size()); }
+
+        size_t size() const { return blocks.size() * BLOCK_VALUES + tail_count; }
+        bool empty() const { return size() == 0; }
+        size_t capacity() const { return (blocks.size() + 1) * BLOCK_VALUES; }
+
+        /**
+         * Get the heap bytes held by the packed blocks
+         */
+        size_t memory_bytes() const { return blocks.capacity() * sizeof(Block) + words.capacity() * sizeof(Unsigned); }
+
+        Allocator get_allocator() const { return Allocator(blocks.get_allocator()); }
+
+        // ================== MODIFIERS ==================
+
+        void push_back(T value) {
+            tail[tail_count++] = value;
+            if (tail_count == BLOCK_VALUES) {
+                pack_tail();
+            }
+        }
+
+        template<typename... Args> void emplace_back(Args&&... args) {
+            push_back(T(std::forward<Args>(args)...));
+        }
+
+        /**
+         * Erase every value that satisfies pred - decodes once, then repacks the survivors
+         * @param pred Called with each value, in order
+         * @return Number of values erased
+         */
+        template<typename Predicate> size_t erase_if(Predicate pred) {
+            std::vector<T, Allocator> kept(get_allocator());
+            kept.reserve(size());
+            for (size_t block = 0; block < blocks.size(); ++block) {
+                std::array<T, BLOCK_VALUES> buffer = decode_block(block);
+                std::copy_if(buffer.begin(), buffer.end(), std::back_inserter(kept), [&pred](T value) { return !pred(value); });
+            }
+            std::copy_if(tail.begin(), tail.begin() + tail_count, std::back_inserter(kept), [&pred](T value) { return !pred(value); });
+
+            size_t removed = size() - kept.size();
+            clear();
+            for (T value : kept) {
+                push_back(value);
+            }
+            return removed;
+        }
+
+        void reserve(size_t n) {
+            blocks.reserve(n / BLOCK_VALUES);
+        }
+
+        void shrink_to_fit() {
+            blocks.shrink_to_fit();
+            words.shrink_to_fit();
+        }
+
+        void clear() {
+            blocks.clear();
+            words.clear();
+            tail_count = 0;
+        }
+    };
+
+    /**
+     * MyContainer over bit-packed integers
+     */
+    template<typename T = int, typename Allocator = std::allocator<T>>
+    using PackedContainer = MyContainer<T, Allocator, PackedStorage<T, Allocator>>;
+
+} // End of ex4 namespace
+
+#endif // PACKEDSTORAGE_HPP
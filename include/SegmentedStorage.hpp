@@ -0,0 +1,325 @@
+// Nitzanwa@gmail.com
+
+#ifndef SEGMENTEDSTORAGE_HPP
+#define SEGMENTEDSTORAGE_HPP
+
+#include "MyContainer.hpp"
+#include <memory>
+#include <algorithm>
+#include <bit>
+#include <initializer_list>
+#include <array>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace ex4 {
+
+    /**
+     * SegmentedStorage - vector-like storage made of fixed-size blocks
+     *
+     * Elements live in blocks of BlockSize elements obtained from Allocator. The block pointers live
+     * in a two-level table: a fixed array of pages, where page k holds first_page << k block pointers.
+     * Pages are allocated on demand and never copied, so appending allocates at most one block and
+     * one page, never moves existing elements or block pointers, and add() has bounded worst-case
+     * latency regardless of size. References stay valid.
+     * Used as the Storage parameter of MyContainer (see SegmentedContainer below).
+     */
+    template<typename T, size_t BlockSize = 4096, typename Allocator = std::allocator<T>> class SegmentedStorage {
+        static_assert(BlockSize > 0 && (BlockSize & (BlockSize - 1)) == 0, "BlockSize must be a power of two");
+
+        using AllocatorTraits = std::allocator_traits<Allocator>;
+        using PageAllocator = typename AllocatorTraits::template rebind_alloc<T*>;
+        using PageTraits = std::allocator_traits<PageAllocator>;
+
+        static constexpr size_t block_shift = static_cast<size_t>(std::countr_zero(BlockSize));
+        static constexpr size_t block_mask = BlockSize - 1;
+
+        // Page k holds first_page << k block pointers and starts at block first_page * (2^k - 1);
+        // enough pages to address every size_t index
+        static constexpr size_t first_page = 8;
+        static constexpr size_t first_page_shift = 3;
+        static constexpr size_t page_limit = std::numeric_limits<size_t>::digits - block_shift - first_page_shift;
+
+        using PageTable = std::array<T**, page_limit>;
+
+        static size_t page_of(size_t block) {
+            return static_cast<size_t>(std::bit_width((block >> first_page_shift) + 1)) - 1;
+        }
+
+        static size_t page_start(size_t page) { return first_page * ((size_t{1} << page) - 1); }
+
+        static size_t page_length(size_t page) { return first_page << page; }
+
+        /**
+         * Find an element through the page table
+         */
+        static T& locate(const PageTable& pages, size_t index) {
+            size_t block = index >> block_shift;
+            size_t page = page_of(block);
+            return pages[page][block - page_start(page)][index & block_mask];
+        }
+
+    public:
+        using value_type = T;
+        using allocator_type = Allocator;
+        using size_type = size_t;
+        using reference = T&;
+        using const_reference = const T&;
+        using iterator = detail::IndexIterator<SegmentedStorage, T&>;
+        using const_iterator = detail::IndexIterator<const SegmentedStorage, const T&>;
+
+        static constexpr size_t block_size = BlockSize;
+
+    private:
+        [[no_unique_address]] Allocator allocator;
+        PageTable pages{};
+        size_t blocks = 0;
+        size_t count = 0;
+
+        /**
+         * Allocate one block, and the page that will hold its pointer when it starts a new page
+         */
+        void add_block() {
+            size_t page = page_of(blocks);
+            if (page >= page_limit) {
+                throw std::length_error("SegmentedStorage: too many blocks");
+            }
+            bool new_page = blocks == page_start(page);
+            if (new_page) {
+                PageAllocator page_allocator(allocator);
+                pages[page] = PageTraits::allocate(page_allocator, page_length(page));
+            }
+            try {
+                pages[page][blocks - page_start(page)] = AllocatorTraits::allocate(allocator, BlockSize);
+            } catch (...) {
+                if (new_page) {
+                    PageAllocator page_allocator(allocator);
+                    PageTraits::deallocate(page_allocator, pages[page], page_length(page));
+                    pages[page] = nullptr;
+                }
+                throw;
+            }
+            ++blocks;
+        }
+
+        /**
+         * Return the blocks from first_block on, and the pages left empty, to the allocator
+         * (the blocks must hold no live elements)
+         */
+        void release_blocks_from(size_t first_block) {
+            PageAllocator page_allocator(allocator);
+            while (blocks > first_block) {
+                --blocks;
+                size_t page = page_of(blocks);
+                AllocatorTraits::deallocate(allocator, pages[page][blocks - page_start(page)], BlockSize);
+                if (blocks == page_start(page)) {
+                    PageTraits::deallocate(page_allocator, pages[page], page_length(page));
+                    pages[page] = nullptr;
+                }
+            }
+        }
+
+        /**
+         * Take over other's blocks when allowed, move element-wise otherwise
+         */
+        void take_from(SegmentedStorage& other) {
+            if (allocator == other.allocator) {
+                pages = std::exchange(other.pages, PageTable{});
+                blocks = std::exchange(other.blocks, 0);
+                count = std::exchange(other.count, 0);
+                return;
+            }
+            reserve(other.count);
+            for (size_t i = 0; i < other.count; ++i) {
+                emplace_back(std::move(other[i]));
+            }
+            other.clear();
+        }
+
+    public:
+        // ================== CONSTRUCTORS & DESTRUCTOR ==================
+
+        SegmentedStorage() = default;
+
+        explicit SegmentedStorage(const Allocator& alloc) : allocator(alloc) {}
+
+        SegmentedStorage(size_t n, const T& value, const Allocator& alloc = Allocator()) : SegmentedStorage(alloc) {
+            resize(n, value);
+        }
+
+        SegmentedStorage(size_t n, const Allocator& alloc) : SegmentedStorage(alloc) {
+            resize(n);
+        }
+
+        SegmentedStorage(std::initializer_list<T> values, const Allocator& alloc = Allocator())
+            : SegmentedStorage(values.begin(), values.end(), alloc) {}
+
+        template<std::input_iterator InputIt>
+        SegmentedStorage(InputIt first, InputIt last, const Allocator& alloc = Allocator()) : SegmentedStorage(alloc) {
+            if constexpr (std::forward_iterator<InputIt>) {
+                reserve(static_cast<size_t>(std::distance(first, last)));
+            }
+            for (; first != last; ++first) {
+                emplace_back(*first);
+            }
+        }
+
+        SegmentedStorage(const SegmentedStorage& other)
+            : SegmentedStorage(other, AllocatorTraits::select_on_container_copy_construction(other.allocator)) {}
+
+        SegmentedStorage(const SegmentedStorage& other, const Allocator& alloc)
+            : SegmentedStorage(other.begin(), other.end(), alloc) {}
+
+        SegmentedStorage(SegmentedStorage&& other) noexcept
+            : allocator(other.allocator),
+              pages(std::exchange(other.pages, PageTable{})),
+              blocks(std::exchange(other.blocks, 0)),
+              count(std::exchange(other.count, 0)) {}
+
+        SegmentedStorage& operator=(const SegmentedStorage& other) {
+            if (this != &other) {
+                clear();
+                reserve(other.count);
+                for (size_t i = 0; i < other.count; ++i) {
+                    emplace_back(other[i]);
+                }
+            }
+            return *this;
+        }
+
+        SegmentedStorage& operator=(SegmentedStorage&& other) {
+            if (this != &other) {
+                clear();
+                release_blocks_from(0);
+                if constexpr (AllocatorTraits::propagate_on_container_move_assignment::value) {
+                    allocator = other.allocator;
+                }
+                take_from(other);
+            }
+            return *this;
+        }
+
+        ~SegmentedStorage() {
+            clear();
+            release_blocks_from(0);
+        }
+
+        // ================== ACCESS ==================
+
+        T& operator[](size_t index) { return locate(pages, index); }
+        const T& operator[](size_t index) const { return locate(pages, index); }
+
+        iterator begin() { return iterator(this, 0); }
+        iterator end() { return iterator(this, count); }
+        const_iterator begin() const { return const_iterator(this, 0); }
+        const_iterator end() const { return const_iterator(this, count); }
+
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        size_t capacity() const { return blocks * BlockSize; }
+
+        /**
+         * Get the number of blocks currently allocated
+         * @return Number of BlockSize-element blocks
+         */
+        size_t block_count() const { return blocks; }
+
+        /**
+         * Get the heap bytes held by the blocks and the pages of the block table
+         */
+        size_t memory_bytes() const {
+            size_t page_slots = blocks == 0 ? 0 : page_start(page_of(blocks - 1) + 1);
+            return blocks * BlockSize * sizeof(T) + page_slots * sizeof(T*);
+        }
+
+        Allocator get_allocator() const { return allocator; }
+
+        // ================== MODIFIERS ==================
+
+        /**
+         * Construct an element at the end - allocates one block (and at most one page of the
+         * block table) when the last block is full, never moves existing elements
+         */
+        template<typename... Args> T& emplace_back(Args&&... args) {
+            if (count == capacity()) {
+                add_block();
+            }
+            T* slot = &(*this)[count];
+            AllocatorTraits::construct(allocator, slot, std::forward<Args>(args)...);
+            ++count;
+            return *slot;
+        }
+
+        void push_back(const T& value) { emplace_back(value); }
+        void push_back(T&& value) { emplace_back(std::move(value)); }
+
+        /**
+         * Erase [first, last), shifting the tail down
+         * @return Iterator to the element that followed the erased range
+         */
+        iterator erase(const_iterator first, const_iterator last) {
+            iterator target = begin() + (first - begin());
+            iterator new_end = std::move(begin() + (last - begin()), end(), target);
+            for (size_t i = static_cast<size_t>(new_end - begin()); i < count; ++i) {
+                AllocatorTraits::destroy(allocator, &(*this)[i]);
+            }
+            count = static_cast<size_t>(new_end - begin());
+            return target;
+        }
+
+        void resize(size_t n) {
+            reserve(n);
+            while (count < n) emplace_back();
+            while (count > n) AllocatorTraits::destroy(allocator, &(*this)[--count]);
+        }
+
+        void resize(size_t n, const T& value) {
+            reserve(n);
+            while (count < n) emplace_back(value);
+            while (count > n) AllocatorTraits::destroy(allocator, &(*this)[--count]);
+        }
+
+        /**
+         * Allocate blocks until at least n elements fit
+         */
+        void reserve(size_t n) {
+            while (capacity() < n) {
+                add_block();
+            }
+        }
+
+        /**
+         * Release the blocks past the last element
+         */
+        void shrink_to_fit() {
+            release_blocks_from((count + BlockSize - 1) / BlockSize);
+        }
+
+        void clear() {
+            for (size_t i = 0; i < count; ++i) {
+                AllocatorTraits::destroy(allocator, &(*this)[i]);
+            }
+            count = 0;
+        }
+    };
+
+    namespace detail {
+
+        // Blocks are added one at a time - doubling would allocate as many blocks as are in use
+        template<typename T, size_t BlockSize, typename Allocator>
+        struct geometric_reserve<SegmentedStorage<T, BlockSize, Allocator>> : std::false_type {};
+
+    } // End of detail namespace
+
+    /**
+     * MyContainer whose add() never reallocates or moves existing elements
+     */
+    template<typename T, size_t BlockSize = 4096, typename Allocator = std::allocator<T>>
+    using SegmentedContainer = MyContainer<T, Allocator, SegmentedStorage<T, BlockSize, Allocator>>;
+
+} // End of ex4 namespace
+
+#endif // SEGMENTEDSTORAGE_HPP
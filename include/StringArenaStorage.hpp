@@ -0,0 +1,242 @@
+// Nitzanwa@gmail.com
+
+#ifndef STRINGARENASTORAGE_HPP
+#define STRINGARENASTORAGE_HPP
+
+#include "MyContainer.hpp"
+#include <memory>
+#include <algorithm>
+#include <functional>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ex4 {
+
+    /**
+     * StringArenaStorage - storage for MyContainer<std::string> that packs all characters into one arena
+     *
+     * Each element is an 8-byte (offset, length) handle into a single contiguous character buffer, so
+     * there is one allocation for all strings instead of one per long string, sorting compares
+     * sequential memory, and copying the storage copies two flat buffers. Elements are read back as
+     * std::string_view (valid until the next modification). Removed characters are reclaimed by
+     * compacting the arena once they make up more than half of it.
+     *
+     * Template parameter Allocator is the container's std::string allocator; it is rebound for the
+     * arena and the handles
+     */
+    template<typename Allocator = std::allocator<std::string>> class StringArenaStorage {
+        using AllocatorTraits = std::allocator_traits<Allocator>;
+
+        struct Handle {
+            std::uint32_t offset;
+            std::uint32_t length;
+        };
+
+        using Arena = std::vector<char, typename AllocatorTraits::template rebind_alloc<char>>;
+        using Handles = std::vector<Handle, typename AllocatorTraits::template rebind_alloc<Handle>>;
+
+        Arena arena;
+        Handles handles;
+        size_t dead_bytes = 0;  // Arena bytes no longer referenced by any handle
+
+        /**
+         * Rewrite the arena so it holds only live characters, in element order
+         */
+        void compact() {
+            Arena packed(arena.get_allocator());
+            packed.reserve(arena.size() - dead_bytes);
+            for (Handle& handle : handles) {
+                size_t offset = packed.size();
+                packed.insert(packed.end(), arena.begin() + handle.offset, arena.begin() + handle.offset + handle.length);
+                handle.offset = static_cast<std::uint32_t>(offset);
+            }
+            arena = std::move(packed);
+            dead_bytes = 0;
+        }
+
+    public:
+        using value_type = std::string;
+        using allocator_type = Allocator;
+        using size_type = size_t;
+        using reference = std::string_view;
+        using const_reference = std::string_view;
+        using const_iterator = detail::IndexIterator<const StringArenaStorage, std::string_view>;
+        using iterator = const_iterator;
+
+        // ================== CONSTRUCTORS ==================
+
+        StringArenaStorage() = default;
+
+        explicit StringArenaStorage(const Allocator& alloc) : arena(alloc), handles(alloc) {}
+
+        template<typename U> requires std::is_convertible_v<const U&, std::string_view>
+        StringArenaStorage(std::initializer_list<U> values, const Allocator& alloc = Allocator())
+            : StringArenaStorage(values.begin(), values.end(), alloc) {}
+
+        template<std::input_iterator InputIt>
+        StringArenaStorage(InputIt first, InputIt last, const Allocator& alloc = Allocator()) : StringArenaStorage(alloc) {
+            if constexpr (std::forward_iterator<InputIt>) {
+                reserve(static_cast<size_t>(std::distance(first, last)));
+            }
+            for (; first != last; ++first) {
+                emplace_back(*first);
+            }
+        }
+
+        StringArenaStorage(const StringArenaStorage& other) = default;
+
+        StringArenaStorage(const StringArenaStorage& other, const Allocator& alloc)
+            : arena(other.arena, alloc), handles(other.handles, alloc), dead_bytes(other.dead_bytes) {}
+
+        StringArenaStorage(StringArenaStorage&& other) noexcept
+            : arena(std::move(other.arena)), handles(std::move(other.handles)), dead_bytes(std::exchange(other.dead_bytes, 0)) {
+            other.clear();
+        }
+
+        StringArenaStorage& operator=(const StringArenaStorage& other) = default;
+
+        StringArenaStorage& operator=(StringArenaStorage&& other) {
+            if (this != &other) {
+                arena = std::move(other.arena);
+                handles = std::move(other.handles);
+                dead_bytes = std::exchange(other.dead_bytes, 0);
+                other.clear();
+            }
+            return *this;
+        }
+
+        // ================== ACCESS ==================
+
+        std::string_view operator[](size_t index) const {
+            const Handle& handle = handles[index];
+            return std::string_view(arena.data() + handle.offset, handle.length);
+        }
+
+        const_iterator begin() const { return const_iterator(this, 0); }
+        const_iterator end() const { return const_iterator(this, handles.size()); }
+
+        size_t size() const { return handles.size(); }
+        bool empty() const { return handles.empty(); }
+        size_t capacity() const { return handles.capacity(); }
+
+        /**
+         * Get the number of characters held in the arena, including ones of removed elements
+         * @return Arena size in bytes
+         */
+        size_t arena_bytes() const { return arena.size(); }
+
+        /**
+         * Get the heap bytes held by the arena and the handles
+         */
+        size_t memory_bytes() const { return arena.capacity() + handles.capacity() * sizeof(Handle); }
+
+        Allocator get_allocator() const { return Allocator(arena.get_allocator()); }
+
+        // ================== MODIFIERS ==================
+
+        /**
+         * Append a string's characters to the arena - no std::string is created.
+         * value may view this arena (e.g. an element read back from this storage).
+         * Strong guarantee: if storing the handle throws, the arena is trimmed back.
+         * @throws std::length_error if the arena would exceed 4 GiB
+         */
+        void push_back(std::string_view value) {
+            size_t offset = arena.size();
+            if (offset + value.size() > std::numeric_limits<std::uint32_t>::max()) {
+                throw std::length_error("StringArenaStorage arena is limited to 4 GiB");
+            }
+            // A view into the arena is copied by offset - growing would free the characters it points
+            // at, and vector::insert must not be given a range into the vector itself
+            std::less<const char*> before;
+            bool aliased = !value.empty() && !before(value.data(), arena.data()) && before(value.data(), arena.data() + offset);
+            size_t source = aliased ? static_cast<size_t>(value.data() - arena.data()) : 0;
+            if (offset + value.size() > arena.capacity()) {
+                arena.reserve(std::max(offset + value.size(), 2 * arena.capacity()));
+            }
+            arena.resize(offset + value.size());
+            if (!value.empty()) {
+                std::memcpy(arena.data() + offset, aliased ? arena.data() + source : value.data(), value.size());
+            }
+            try {
+                handles.push_back(Handle{static_cast<std::uint32_t>(offset), static_cast<std::uint32_t>(value.size())});
+            } catch (...) {
+                arena.resize(offset);
+                throw;
+            }
+        }
+
+        /**
+         * Append an element built from args - views and character pointers are copied into the arena
+         * directly, anything else goes through std::string first
+         */
+        template<typename... Args> void emplace_back(Args&&... args) {
+            if constexpr (std::is_constructible_v<std::string_view, Args&&...>) {
+                push_back(std::string_view(std::forward<Args>(args)...));
+            } else {
+                push_back(std::string(std::forward<Args>(args)...));
+            }
+        }
+
+        /**
+         * Erase every element that satisfies pred in one pass over the handles
+         * @param pred Called with the std::string_view of each element, in order
+         * @return Number of elements erased
+         */
+        template<typename Predicate> size_t erase_if(Predicate pred) {
+            size_t kept = 0;
+            for (size_t i = 0; i < handles.size(); ++i) {
+                if (pred((*this)[i])) {
+                    dead_bytes += handles[i].length;
+                } else {
+                    handles[kept++] = handles[i];
+                }
+            }
+            size_t removed = handles.size() - kept;
+            handles.resize(kept);
+            if (dead_bytes * 2 > arena.size()) {
+                compact();
+            }
+            return removed;
+        }
+
+        /**
+         * Reserve room for n handles
+         */
+        void reserve(size_t n) { handles.reserve(n); }
+
+        /**
+         * Drop the characters of removed elements and release spare capacity
+         */
+        void shrink_to_fit() {
+            if (dead_bytes > 0) {
+                compact();
+            }
+            arena.shrink_to_fit();
+            handles.shrink_to_fit();
+        }
+
+        void clear() {
+            arena.clear();
+            handles.clear();
+            dead_bytes = 0;
+        }
+    };
+
+    /**
+     * MyContainer<std::string> whose strings share one character arena
+     */
+    template<typename Allocator = std::allocator<std::string>>
+    using StringArenaContainer = MyContainer<std::string, Allocator, StringArenaStorage<Allocator>>;
+
+} // End of ex4 namespace
+
+#endif // STRINGARENASTORAGE_HPP
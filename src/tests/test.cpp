@@ -3,8 +3,25 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest.h"
 #include "MyContainer.hpp"
+#include "InlineStorage.hpp"
+#include "MyStaticContainer.hpp"
+#include "SegmentedStorage.hpp"
+#include "MappedStorage.hpp"
+#include "StringArenaStorage.hpp"
+#include "MyCountedContainer.hpp"
+#include "PackedStorage.hpp"
 #include <string>
 #include <vector>
+#include <type_traits>
+#include <memory>
+#include <array>
+#include <sstream>
+#include <filesystem>
+#include <thread>
+#include <atomic>
+#include <execution>
+#include <cstdlib>
+#include <new>
 
 using namespace ex4;
 
@@ -373,6 +390,34 @@ TEST_CASE("Postfix Iterator Operators") {
         }
     }
     
+    SUBCASE("Iterators are trivially copyable handles") {
+        CHECK(std::is_trivially_copyable_v<MyContainer<int>::AscendingIterator>);
+        CHECK(std::is_trivially_copyable_v<MyContainer<int>::DescendingIterator>);
+        CHECK(std::is_trivially_copyable_v<MyContainer<int>::SideCrossIterator>);
+        CHECK(std::is_trivially_copyable_v<MyContainer<int>::ReverseIterator>);
+        CHECK(std::is_trivially_copyable_v<MyContainer<int>::OrderIterator>);
+        CHECK(std::is_trivially_copyable_v<MyContainer<int>::MiddleOutIterator>);
+        CHECK(sizeof(MyContainer<std::string>::AscendingIterator) <= 4 * sizeof(void*));
+    }
+
+    SUBCASE("Postfix on a large container returns the old position") {
+        MyContainer<int> large;
+        const int count = 100000;
+        for (int i = 0; i < count; ++i) {
+            large.add(static_cast<int>((static_cast<long long>(i) * 7919) % count));
+        }
+
+        // 7919 is prime, so the values are a permutation of 0..count-1
+        int expected = 0;
+        bool in_step = true;
+        for (auto it = large.begin_ascending_order(); it != large.end_ascending_order(); ) {
+            auto before = it++;
+            in_step = in_step && *before == expected++ && it - before == 1;
+        }
+        CHECK(in_step);
+        CHECK(expected == count);
+    }
+    
     SUBCASE("Using postfix in for loop") {
         std::vector<int> result;
         for (auto it = container.begin_ascending_order(); it != container.end_ascending_order(); it++) {
@@ -381,4 +426,1748 @@ TEST_CASE("Postfix Iterator Operators") {
         std::vector<int> expected = {10, 20, 30};
         CHECK(result == expected);
     }
+}
+
+struct CompareCounted {
+    static long comparisons;
+    int value;
+
+    CompareCounted(int v) : value(v) {}
+    bool operator<(const CompareCounted& other) const { ++comparisons; return value < other.value; }
+    bool operator==(const CompareCounted& other) const { return value == other.value; }
+};
+long CompareCounted::comparisons = 0;
+
+TEST_CASE("Sorted Snapshot Cache") {
+    MyContainer<int> container;
+    container.add(7);
+    container.add(15);
+    container.add(6);
+
+    SUBCASE("Repeated traversals of an unchanged container agree") {
+        CHECK(toVector(container, "ascending") == std::vector<int>({6, 7, 15}));
+        CHECK(toVector(container, "ascending") == std::vector<int>({6, 7, 15}));
+        CHECK(toVector(container, "descending") == std::vector<int>({15, 7, 6}));
+        CHECK(toVector(container, "side_cross") == std::vector<int>({6, 15, 7}));
+    }
+
+    SUBCASE("add() and remove() invalidate the snapshot") {
+        CHECK(toVector(container, "ascending") == std::vector<int>({6, 7, 15}));
+        container.add(1);
+        CHECK(toVector(container, "ascending") == std::vector<int>({1, 6, 7, 15}));
+        container.remove(15);
+        CHECK(toVector(container, "descending") == std::vector<int>({7, 6, 1}));
+        CHECK(toVector(container, "side_cross") == std::vector<int>({1, 7, 6}));
+    }
+
+    SUBCASE("An unchanged container sorts once") {
+        MyContainer<CompareCounted> counted;
+        for (int i = 0; i < 1000; ++i) {
+            counted.add(CompareCounted((i * 37) % 1000));
+        }
+        CompareCounted::comparisons = 0;
+        long sum = 0;
+        for (auto it = counted.begin_ascending_order(); it != counted.end_ascending_order(); ++it) {
+            sum += it->value;
+        }
+        CHECK(CompareCounted::comparisons > 0);
+
+        // Later traversals in any sorted order reuse the snapshot
+        CompareCounted::comparisons = 0;
+        auto first = counted.begin_ascending_order();
+        auto second = counted.begin_ascending_order();
+        CHECK(first->value == 0);
+        CHECK(second->value == 0);
+        for (auto it = counted.begin_descending_order(); it != counted.end_descending_order(); ++it) {
+            sum -= it->value;
+        }
+        for (auto it = counted.begin_side_cross_order(); it != counted.end_side_cross_order(); ++it) {
+            sum += it->value;
+        }
+        CHECK(sum == 999 * 1000 / 2);
+        CHECK(CompareCounted::comparisons == 0);
+    }
+}
+
+TEST_CASE("End Iterators") {
+    MyContainer<int> container;
+    container.add(3);
+    container.add(1);
+    container.add(2);
+
+    SUBCASE("Dereferencing an end iterator throws") {
+        CHECK_THROWS_AS(*container.end_ascending_order(), std::out_of_range);
+        CHECK_THROWS_AS(*container.end_descending_order(), std::out_of_range);
+        CHECK_THROWS_AS(*container.end_side_cross_order(), std::out_of_range);
+        CHECK_THROWS_AS(*container.end_reverse_order(), std::out_of_range);
+        CHECK_THROWS_AS(*container.end_order(), std::out_of_range);
+        CHECK_THROWS_AS(*container.end_middle_out_order(), std::out_of_range);
+    }
+
+    SUBCASE("Advancing begin reaches end") {
+        auto it = container.begin_side_cross_order();
+        ++it; ++it; ++it;
+        CHECK(it == container.end_side_cross_order());
+
+        auto middle = container.begin_middle_out_order();
+        ++middle; ++middle; ++middle;
+        CHECK(middle == container.end_middle_out_order());
+    }
+}
+
+// Element type that counts how many times it was copied
+struct CopyCounted {
+    static int copies;
+    int value;
+
+    CopyCounted(int v) : value(v) {}
+    CopyCounted(const CopyCounted& other) : value(other.value) { ++copies; }
+    CopyCounted(CopyCounted&& other) noexcept = default;
+    CopyCounted& operator=(const CopyCounted& other) { value = other.value; ++copies; return *this; }
+    CopyCounted& operator=(CopyCounted&& other) noexcept = default;
+
+    bool operator<(const CopyCounted& other) const { return value < other.value; }
+    bool operator==(const CopyCounted& other) const { return value == other.value; }
+};
+int CopyCounted::copies = 0;
+
+TEST_CASE("Ordered Iterators Do Not Copy Elements") {
+    MyContainer<CopyCounted> container;
+    container.add(CopyCounted(4));
+    container.add(CopyCounted(9));
+    container.add(CopyCounted(1));
+    container.add(CopyCounted(6));
+
+    CopyCounted::copies = 0;
+
+    std::vector<int> ascending;
+    for (auto it = container.begin_ascending_order(); it != container.end_ascending_order(); ++it) {
+        ascending.push_back((*it).value);
+    }
+    std::vector<int> descending;
+    for (auto it = container.begin_descending_order(); it != container.end_descending_order(); ++it) {
+        descending.push_back((*it).value);
+    }
+    std::vector<int> side_cross;
+    for (auto it = container.begin_side_cross_order(); it != container.end_side_cross_order(); ++it) {
+        side_cross.push_back((*it).value);
+    }
+
+    CHECK(ascending == std::vector<int>({1, 4, 6, 9}));
+    CHECK(descending == std::vector<int>({9, 6, 4, 1}));
+    CHECK(side_cross == std::vector<int>({1, 9, 4, 6}));
+    CHECK(CopyCounted::copies == 0);
+}
+
+// Element type that counts how many times it was compared
+TEST_CASE("Lazy Sorted Iteration") {
+    const int count = 100000;
+    MyContainer<CompareCounted> container;
+    std::vector<int> values;
+    unsigned int seed = 12345;
+    for (int i = 0; i < count; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        int value = static_cast<int>((seed >> 8) % 50000);  // Plenty of duplicates
+        values.push_back(value);
+        container.add(CompareCounted(value));
+    }
+    std::vector<int> sorted_values = values;
+    std::sort(sorted_values.begin(), sorted_values.end());
+
+    SUBCASE("Taking the smallest few does not sort everything") {
+        CompareCounted::comparisons = 0;
+        std::vector<int> smallest;
+        for (auto it = container.begin_ascending_order(); it != container.end_ascending_order() && smallest.size() < 50; ++it) {
+            smallest.push_back((*it).value);
+        }
+        CHECK(smallest == std::vector<int>(sorted_values.begin(), sorted_values.begin() + 50));
+        CHECK(CompareCounted::comparisons < 8L * count);
+    }
+
+    SUBCASE("Taking the largest few does not sort everything") {
+        CompareCounted::comparisons = 0;
+        std::vector<int> largest;
+        for (auto it = container.begin_descending_order(); it != container.end_descending_order() && largest.size() < 50; ++it) {
+            largest.push_back((*it).value);
+        }
+        CHECK(largest == std::vector<int>(sorted_values.rbegin(), sorted_values.rbegin() + 50));
+        CHECK(CompareCounted::comparisons < 8L * count);
+    }
+
+    SUBCASE("Full traversal matches std::sort") {
+        std::vector<int> ascending;
+        for (auto it = container.begin_ascending_order(); it != container.end_ascending_order(); ++it) {
+            ascending.push_back((*it).value);
+        }
+        CHECK(ascending == sorted_values);
+    }
+
+    SUBCASE("Threads can share a lazily sorted container") {
+        const MyContainer<int> shared(values.begin(), values.end());
+        std::vector<std::vector<int>> seen(4);
+        std::vector<std::thread> readers;
+        for (size_t t = 0; t < seen.size(); ++t) {
+            readers.emplace_back([&shared, &seen, t]() {
+                // Each reader visits the ranks in its own order, so they settle different runs at the same time
+                const size_t steps[] = {1, 3, 7919, 99991};
+                auto first = shared.begin_ascending_order();
+                for (size_t i = 0; i < shared.size(); ++i) {
+                    seen[t].push_back(first[(i * steps[t]) % shared.size()]);
+                }
+                std::sort(seen[t].begin(), seen[t].end());
+            });
+        }
+        for (std::thread& reader : readers) {
+            reader.join();
+        }
+        for (const std::vector<int>& result : seen) {
+            CHECK(result == sorted_values);
+        }
+        CHECK(toVector(shared, "descending") == std::vector<int>(sorted_values.rbegin(), sorted_values.rend()));
+    }
+}
+
+TEST_CASE("Random Access Iterators") {
+    MyContainer<int> container;
+    container.add(7);
+    container.add(15);
+    container.add(6);
+    container.add(1);
+    container.add(2);
+
+    SUBCASE("Iterator traits report random access") {
+        using Category = std::iterator_traits<MyContainer<int>::AscendingIterator>::iterator_category;
+        CHECK(std::is_same_v<Category, std::random_access_iterator_tag>);
+        CHECK(std::is_same_v<std::iterator_traits<MyContainer<int>::MiddleOutIterator>::iterator_category,
+                             std::random_access_iterator_tag>);
+        CHECK(std::is_same_v<std::iterator_traits<MyContainer<int>::OrderIterator>::value_type, int>);
+    }
+
+    SUBCASE("Distance, advance and subscript") {
+        CHECK(std::distance(container.begin_order(), container.end_order()) == 5);
+        CHECK(container.end_side_cross_order() - container.begin_side_cross_order() == 5);
+
+        auto it = container.begin_descending_order();
+        std::advance(it, 3);
+        CHECK(*it == 2);
+        CHECK(it[-1] == 6);
+        CHECK(container.begin_reverse_order()[4] == 7);
+        CHECK(container.begin_middle_out_order()[2] == 1);
+        CHECK(*(2 + container.begin_ascending_order()) == 6);
+    }
+
+    SUBCASE("Decrement and ordering") {
+        auto end = container.end_ascending_order();
+        auto last = end - 1;
+        CHECK(*last == 15);
+        CHECK(*--last == 7);
+        CHECK(*last-- == 7);
+        CHECK(*last == 6);
+        CHECK(container.begin_ascending_order() < last);
+        CHECK(last <= last);
+        CHECK(end > last);
+        CHECK(end >= end);
+    }
+
+    SUBCASE("Binary search over the ascending order") {
+        auto found = std::lower_bound(container.begin_ascending_order(), container.end_ascending_order(), 7);
+        CHECK(found - container.begin_ascending_order() == 3);
+        CHECK(*found == 7);
+        CHECK(std::binary_search(container.begin_ascending_order(), container.end_ascending_order(), 15));
+        CHECK_FALSE(std::binary_search(container.begin_ascending_order(), container.end_ascending_order(), 8));
+    }
+
+    SUBCASE("Parallel algorithms over the sorted orders") {
+        MyContainer<int> large;
+        const int count = 100000;
+        for (int i = 0; i < count; ++i) {
+            large.add(static_cast<int>((static_cast<long long>(i) * 7919) % count));
+        }
+        large.sort_now();
+
+        std::atomic<long long> sum{0};
+        std::for_each(std::execution::par, large.begin_ascending_order(), large.end_ascending_order(), 
+                      [&sum](int value) { sum += value; });
+        CHECK(sum == static_cast<long long>(count) * (count - 1) / 2);
+
+        std::vector<int> copied(count);
+        std::copy(std::execution::par, large.begin_descending_order(), large.end_descending_order(), copied.begin());
+        CHECK(std::is_sorted(copied.rbegin(), copied.rend()));
+        CHECK(std::count_if(std::execution::par, large.begin_side_cross_order(), large.end_side_cross_order(), 
+                            [](int value) { return value % 2 == 0; }) == count / 2);
+
+        // Without sort_now() the workers settle the index under its lock - slower, still correct
+        const MyContainer<int> lazy(large);
+        std::vector<int> lazy_copy(count);
+        std::copy(std::execution::par, lazy.begin_ascending_order(), lazy.end_ascending_order(), lazy_copy.begin());
+        CHECK(std::is_sorted(lazy_copy.begin(), lazy_copy.end()));
+    }
+}
+
+TEST_CASE("Side Cross and Middle Out Position Mapping") {
+    // Reference orders built the way the original iterators materialized them
+    auto side_cross_reference = [](std::vector<int> values) {
+        std::sort(values.begin(), values.end());
+        std::vector<int> result;
+        size_t left = 0;
+        size_t right = values.size() - 1;
+        bool take_from_left = true;
+        while (left <= right && right < values.size()) {
+            result.push_back(take_from_left ? values[left++] : values[right--]);
+            take_from_left = !take_from_left;
+        }
+        return result;
+    };
+    auto middle_out_reference = [](const std::vector<int>& values) {
+        std::vector<int> result;
+        size_t middle = values.size() / 2;
+        result.push_back(values[middle]);
+        for (size_t distance = 1; distance < values.size(); ++distance) {
+            if (middle >= distance) result.push_back(values[middle - distance]);
+            if (middle + distance < values.size()) result.push_back(values[middle + distance]);
+        }
+        return result;
+    };
+
+    for (int size = 1; size <= 12; ++size) {
+        CAPTURE(size);
+        MyContainer<int> container;
+        std::vector<int> values;
+        for (int i = 0; i < size; ++i) {
+            int value = (i * 7 + 3) % 11;
+            values.push_back(value);
+            container.add(value);
+        }
+        CHECK(toVector(container, "side_cross") == side_cross_reference(values));
+        CHECK(toVector(container, "middle_out") == middle_out_reference(values));
+    }
+}
+
+TEST_CASE("Order and Reverse Views") {
+    MyContainer<int> container;
+    container.add(4);
+    container.add(8);
+    container.add(2);
+
+    SUBCASE("Iterators read the live storage") {
+        auto first = container.begin_order();
+        CHECK(&*first == &*container.begin_order());
+        CHECK(&*container.begin_reverse_order() == &container.begin_order()[2]);
+    }
+
+    SUBCASE("Using an iterator after modification is caught") {
+        auto order = container.begin_order();
+        auto reverse = container.begin_reverse_order();
+        auto ascending = container.begin_ascending_order();
+        container.add(9);
+        CHECK_THROWS_AS(*order, std::runtime_error);
+        CHECK_THROWS_AS(*reverse, std::runtime_error);
+        CHECK_THROWS_AS(*ascending, std::runtime_error);
+        CHECK_NOTHROW(*container.begin_order());
+
+        auto descending = container.begin_descending_order();
+        container.remove(9);
+        CHECK_THROWS_AS(*descending, std::runtime_error);
+        CHECK_THROWS_AS(descending[1], std::runtime_error);
+    }
+}
+
+TEST_CASE("Range Views") {
+    using Container = MyContainer<int>;
+    static_assert(std::random_access_iterator<Container::AscendingIterator>);
+    static_assert(std::random_access_iterator<Container::MiddleOutIterator>);
+    static_assert(std::ranges::random_access_range<decltype(std::declval<const Container&>().ascending())>);
+    static_assert(std::ranges::sized_range<decltype(std::declval<const Container&>().side_cross())>);
+    static_assert(std::ranges::view<decltype(std::declval<const Container&>().order())>);
+
+    Container container;
+    container.add(7);
+    container.add(15);
+    container.add(6);
+    container.add(1);
+    container.add(2);
+
+    auto collect = [](auto&& range) {
+        std::vector<int> result;
+        for (int value : range) {
+            result.push_back(value);
+        }
+        return result;
+    };
+
+    SUBCASE("Views match the begin/end pairs") {
+        CHECK(collect(container.ascending()) == std::vector<int>({1, 2, 6, 7, 15}));
+        CHECK(collect(container.descending()) == std::vector<int>({15, 7, 6, 2, 1}));
+        CHECK(collect(container.side_cross()) == std::vector<int>({1, 15, 2, 7, 6}));
+        CHECK(collect(container.reverse()) == std::vector<int>({2, 1, 6, 15, 7}));
+        CHECK(collect(container.order()) == std::vector<int>({7, 15, 6, 1, 2}));
+        CHECK(collect(container.middle_out()) == std::vector<int>({6, 15, 1, 7, 2}));
+        CHECK(container.middle_out().size() == 5);
+    }
+
+    SUBCASE("Views compose with standard adaptors") {
+        auto evens_doubled = container.ascending()
+            | std::views::filter([](int value) { return value % 2 == 0; })
+            | std::views::transform([](int value) { return value * 2; });
+        CHECK(collect(evens_doubled) == std::vector<int>({4, 12}));
+        CHECK(collect(container.descending() | std::views::take(2)) == std::vector<int>({15, 7}));
+    }
+
+    SUBCASE("take(k) over the ascending view does not sort everything") {
+        MyContainer<CompareCounted> large;
+        const int count = 100000;
+        for (int i = 0; i < count; ++i) {
+            large.add(CompareCounted((i * 7919) % count));
+        }
+        CompareCounted::comparisons = 0;
+        std::vector<int> smallest;
+        for (const CompareCounted& element : large.ascending() | std::views::take(10)) {
+            smallest.push_back(element.value);
+        }
+        CHECK(smallest == std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+        CHECK(CompareCounted::comparisons < 8L * count);
+    }
+}
+
+TEST_CASE("Sorted Index Absorbs Appended Elements") {
+    const int count = 100000;
+    const int appended = 1000;
+    MyContainer<CompareCounted> container;
+    std::vector<int> values;
+    for (int i = 0; i < count; ++i) {
+        int value = (i * 7919) % count;
+        values.push_back(value);
+        container.add(CompareCounted(value));
+    }
+
+    auto ascending_values = [&container]() {
+        std::vector<int> result;
+        for (const CompareCounted& element : container.ascending()) {
+            result.push_back(element.value);
+        }
+        return result;
+    };
+    ascending_values();  // Build the sorted base
+
+    for (int i = 0; i < appended; ++i) {
+        int value = (i * 104729) % (2 * count);
+        values.push_back(value);
+        container.add(CompareCounted(value));
+    }
+    std::sort(values.begin(), values.end());
+
+    SUBCASE("Scan after appending merges instead of re-sorting") {
+        CompareCounted::comparisons = 0;
+        CHECK(ascending_values() == values);
+        CHECK(CompareCounted::comparisons < 2L * count);
+    }
+
+    SUBCASE("Descending and side-cross see the appended elements") {
+        std::vector<int> descending;
+        for (const CompareCounted& element : container.descending()) {
+            descending.push_back(element.value);
+        }
+        CHECK(descending == std::vector<int>(values.rbegin(), values.rend()));
+        CHECK((*container.begin_side_cross_order()).value == values.front());
+        CHECK(container.begin_side_cross_order()[1].value == values.back());
+    }
+
+    SUBCASE("remove() still rebuilds from scratch") {
+        int largest = values.back();
+        container.remove(CompareCounted(largest));
+        values.erase(std::remove(values.begin(), values.end(), largest), values.end());
+        CHECK(ascending_values() == values);
+    }
+}
+
+TEST_CASE("One Sort Serves All Ordered Iterators") {
+    MyContainer<CompareCounted> container;
+    for (int i = 0; i < 1000; ++i) {
+        container.add(CompareCounted((i * 37) % 1000));
+    }
+
+    std::vector<int> ascending;
+    for (const CompareCounted& element : container.ascending()) {
+        ascending.push_back(element.value);
+    }
+
+    CompareCounted::comparisons = 0;
+    std::vector<int> descending;
+    for (const CompareCounted& element : container.descending()) {
+        descending.push_back(element.value);
+    }
+    std::vector<int> side_cross;
+    for (const CompareCounted& element : container.side_cross()) {
+        side_cross.push_back(element.value);
+    }
+
+    CHECK(CompareCounted::comparisons == 0);
+    CHECK(descending == std::vector<int>(ascending.rbegin(), ascending.rend()));
+    CHECK(side_cross.front() == ascending.front());
+    CHECK(side_cross[1] == ascending.back());
+}
+
+TEST_CASE("Move Semantics and Bulk Ingestion") {
+    SUBCASE("Move construction and assignment transfer elements without copies") {
+        std::vector<CopyCounted> loaded;
+        for (int i = 0; i < 100; ++i) {
+            loaded.emplace_back(100 - i);
+        }
+        CopyCounted::copies = 0;
+
+        MyContainer<CopyCounted> source(std::move(loaded));
+        CHECK(source.size() == 100);
+        CHECK((*source.begin_ascending_order()).value == 1);
+
+        MyContainer<CopyCounted> moved(std::move(source));
+        CHECK(moved.size() == 100);
+        CHECK(source.empty());
+        CHECK((*moved.begin_ascending_order()).value == 1);
+
+        MyContainer<CopyCounted> assigned;
+        assigned = std::move(moved);
+        CHECK(assigned.size() == 100);
+        CHECK(moved.empty());
+        CHECK((*assigned.begin_descending_order()).value == 100);
+
+        std::vector<MyContainer<CopyCounted>> containers;
+        for (int i = 0; i < 10; ++i) {
+            containers.push_back(std::move(assigned));
+            assigned = MyContainer<CopyCounted>{};
+        }
+        CHECK(CopyCounted::copies == 0);
+        CHECK(std::is_nothrow_move_constructible_v<MyContainer<std::string>>);
+        CHECK(std::is_nothrow_move_assignable_v<MyContainer<std::string>>);
+    }
+
+    SUBCASE("add(T&&) and emplace work with move-only types") {
+        MyContainer<std::unique_ptr<int>> pointers;
+        pointers.add(std::make_unique<int>(5));
+        pointers.emplace(new int(7));
+        CHECK(pointers.size() == 2);
+        CHECK(**pointers.begin_order() == 5);
+        CHECK(**(pointers.begin_order() + 1) == 7);
+    }
+
+    SUBCASE("Initializer list, range constructor and add_range") {
+        MyContainer<int> listed{7, 15, 6, 1, 2};
+        CHECK(toVector(listed, "order") == std::vector<int>({7, 15, 6, 1, 2}));
+
+        std::vector<int> values = {3, 9, 4};
+        MyContainer<int> ranged(values.begin(), values.end());
+        CHECK(toVector(ranged, "ascending") == std::vector<int>({3, 4, 9}));
+
+        ranged.add_range(values.begin(), values.end());
+        CHECK(ranged.size() == 6);
+        CHECK(toVector(ranged, "ascending") == std::vector<int>({3, 3, 4, 4, 9, 9}));
+    }
+
+    SUBCASE("Repeated small add_range calls grow geometrically") {
+        MyContainer<int> container;
+        int chunk[] = {1, 2, 3, 4};
+        size_t growths = 0;
+        for (int i = 0; i < 50000; ++i) {
+            size_t before = container.capacity();
+            container.add_range(std::begin(chunk), std::end(chunk));
+            growths += container.capacity() != before;
+        }
+        CHECK(container.size() == 200000);
+        CHECK(growths < 40);
+    }
+
+    SUBCASE("reserve and shrink_to_fit") {
+        MyContainer<int> container;
+        container.reserve(1000);
+        CHECK(container.capacity() >= 1000);
+        container.add(1);
+        container.add(2);
+        container.shrink_to_fit();
+        CHECK(container.capacity() == 2);
+        CHECK(toVector(container, "reverse") == std::vector<int>({2, 1}));
+    }
+}
+
+// Memory resource that counts the allocations passed through it
+class CountingResource : public std::pmr::memory_resource {
+public:
+    size_t allocations = 0;
+    size_t bytes_in_use = 0;
+    size_t allocation_limit = std::numeric_limits<size_t>::max();  // Allocations past this many throw
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        if (allocations == allocation_limit) {
+            throw std::bad_alloc();
+        }
+        ++allocations;
+        bytes_in_use += bytes;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+        bytes_in_use -= bytes;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+// Counts allocations from the global heap, i.e. the ones that bypass the allocators under test
+std::atomic<size_t> global_allocations{0};
+
+void* operator new(std::size_t bytes) {
+    ++global_allocations;
+    if (void* p = std::malloc(bytes == 0 ? 1 : bytes)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void* operator new(std::size_t bytes, const std::nothrow_t&) noexcept {
+    ++global_allocations;
+    return std::malloc(bytes == 0 ? 1 : bytes);
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+TEST_CASE("Allocator-Aware Container") {
+    SUBCASE("Elements and sorted index allocate from the memory resource") {
+        CountingResource resource;
+        {
+            ex4::pmr::MyContainer<int> container(&resource);
+            int values[] = {5, 3, 8, 1};
+            container.add_range(std::begin(values), std::end(values));
+            size_t after_elements = resource.allocations;
+            CHECK(after_elements > 0);
+
+            std::vector<int> ascending(container.begin_ascending_order(), container.end_ascending_order());
+            CHECK(ascending == std::vector<int>({1, 3, 5, 8}));
+            CHECK(resource.allocations > after_elements);
+            CHECK(container.get_allocator().resource() == &resource);
+        }
+        CHECK(resource.bytes_in_use == 0);
+    }
+
+    SUBCASE("Merging appended elements allocates only from the resource") {
+        CountingResource resource;
+        ex4::pmr::MyContainer<int> container(&resource);
+        container.reserve(2000);
+        for (int i = 0; i < 1000; ++i) {
+            container.add((i * 7) % 1000);
+        }
+        container.sort_now();
+        for (int i = 0; i < 500; ++i) {
+            container.add(i);
+        }
+
+        size_t global_before = global_allocations;
+        size_t resource_before = resource.allocations;
+        int smallest = *container.begin_ascending_order();  // Merges the appended tail
+        int largest = *container.begin_descending_order();
+        size_t global_used = global_allocations - global_before;
+
+        CHECK(smallest == 0);
+        CHECK(largest == 999);
+        CHECK(global_used == 0);
+        CHECK(resource.allocations > resource_before);
+    }
+
+    SUBCASE("Request-scoped arena frees everything at once") {
+        static std::byte buffer[64 * 1024];
+        std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+        ex4::pmr::MyContainer<int> container(&arena);
+        for (int i = 0; i < 1000; ++i) {
+            container.add((i * 31) % 1000);
+        }
+        CHECK(*container.begin_descending_order() == 999);
+        CHECK(container.begin_side_cross_order()[1] == 999);
+        CHECK(*container.begin_middle_out_order() == (500 * 31) % 1000);
+    }
+
+    SUBCASE("Move assignment between different resources keeps working") {
+        CountingResource first;
+        CountingResource second;
+        ex4::pmr::MyContainer<int> source({4, 2, 9}, &first);
+        CHECK(*source.begin_ascending_order() == 2);
+
+        ex4::pmr::MyContainer<int> target(&second);
+        target = std::move(source);
+        CHECK(target.get_allocator().resource() == &second);
+        CHECK(toVector(target, "ascending") == std::vector<int>({2, 4, 9}));
+    }
+}
+
+struct CopyLimited {
+    static int copies_left;  // Copies allowed before the copy constructor throws
+    int value;
+
+    CopyLimited(int v) : value(v) {}
+    CopyLimited(const CopyLimited& other) : value(other.value) {
+        if (copies_left-- <= 0) {
+            throw std::runtime_error("copy failed");
+        }
+    }
+    CopyLimited(CopyLimited&& other) noexcept(false) : value(other.value) {}
+    CopyLimited& operator=(const CopyLimited&) = default;
+};
+int CopyLimited::copies_left = 100;
+
+TEST_CASE("Small Buffer Storage") {
+    using Allocator = std::pmr::polymorphic_allocator<int>;
+    using Small = ex4::SmallContainer<int, 16, Allocator>;
+
+    SUBCASE("Up to N elements never allocate, in any order") {
+        // null_memory_resource throws on any allocation
+        Small container(std::pmr::null_memory_resource());
+        for (int value : {7, 15, 6, 1, 2, 9, 4, 12}) {
+            container.add(value);
+        }
+        CHECK(toVector(container, "ascending") == std::vector<int>({1, 2, 4, 6, 7, 9, 12, 15}));
+        CHECK(toVector(container, "descending") == std::vector<int>({15, 12, 9, 7, 6, 4, 2, 1}));
+        CHECK(toVector(container, "side_cross") == std::vector<int>({1, 15, 2, 12, 4, 9, 6, 7}));
+        CHECK(toVector(container, "reverse") == std::vector<int>({12, 4, 9, 2, 1, 6, 15, 7}));
+        CHECK(toVector(container, "order") == std::vector<int>({7, 15, 6, 1, 2, 9, 4, 12}));
+        CHECK(*container.begin_middle_out_order() == 2);
+
+        container.add(3);  // Absorbed into the inline index
+        CHECK(*(container.begin_ascending_order() + 2) == 3);
+        container.remove(15);
+        CHECK(*container.begin_descending_order() == 12);
+        CHECK(container.capacity() == 16);
+    }
+
+    SUBCASE("Spills to the allocator past N and returns inline on shrink") {
+        CountingResource resource;
+        {
+            Small container(&resource);
+            for (int i = 0; i < 16; ++i) {
+                container.add(16 - i);
+            }
+            CHECK(*container.begin_ascending_order() == 1);
+            CHECK(resource.allocations == 0);
+
+            container.add(0);
+            CHECK(resource.allocations > 0);
+            CHECK(container.capacity() > 16);
+            CHECK(*container.begin_ascending_order() == 0);
+            CHECK(*container.begin_descending_order() == 16);
+
+            for (int i = 0; i < 4; ++i) {
+                container.remove(i);
+            }
+            container.shrink_to_fit();
+            CHECK(container.capacity() == 16);
+            CHECK(toVector(container, "order") == std::vector<int>({16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4}));
+        }
+        CHECK(resource.bytes_in_use == 0);
+    }
+
+    SUBCASE("Copy and move keep inline elements") {
+        ex4::SmallContainer<std::string, 4> names{"delta", "alpha", "charlie"};
+        ex4::SmallContainer<std::string, 4> copy(names);
+        ex4::SmallContainer<std::string, 4> moved(std::move(names));
+        CHECK(*copy.begin_ascending_order() == "alpha");
+        CHECK(*moved.begin_descending_order() == "delta");
+        CHECK(names.size() == 0);
+    }
+
+    SUBCASE("A throwing copy leaves the storage unchanged") {
+        ex4::InlineStorage<CopyLimited, 4> small{1, 2, 3};
+        ex4::InlineStorage<CopyLimited, 4> large{5, 6, 7, 8, 9};
+
+        CopyLimited::copies_left = 2;
+        CHECK_THROWS_AS(small = large, std::runtime_error);
+        CHECK(small.size() == 3);
+        CHECK(small[2].value == 3);
+
+        // CopyLimited's move may throw, so growing copies - and must not lose the originals
+        CopyLimited::copies_left = 1;
+        CHECK_THROWS_AS(large.emplace_back(10), std::runtime_error);
+        CHECK(large.size() == 5);
+        CHECK(large[4].value == 9);
+        CopyLimited::copies_left = 100;
+    }
+
+    SUBCASE("Move assignment is noexcept only when it cannot allocate") {
+        CHECK(std::is_nothrow_move_assignable_v<ex4::InlineStorage<int, 4>>);
+        CHECK_FALSE(std::is_nothrow_move_assignable_v<ex4::InlineStorage<int, 4, std::pmr::polymorphic_allocator<int>>>);
+    }
+}
+
+namespace {
+    constexpr ex4::MyStaticContainer<int, 8> build_demo_table() {
+        ex4::MyStaticContainer<int, 8> table{7, 15, 6, 1, 2};
+        table.add(15);
+        table.add(1);
+        table.remove(15);
+        return table;
+    }
+
+    template<typename Range, size_t M>
+    constexpr bool matches(const Range& range, const std::array<int, M>& expected) {
+        return std::ranges::equal(range, expected);
+    }
+
+    constexpr auto demo_table = build_demo_table();
+}
+
+TEST_CASE("Static Container Compile-Time Orders") {
+    // Orders computed entirely at compile time
+    constexpr ex4::MyStaticContainer<int, 8> table{7, 15, 6, 1, 2};
+    static_assert(matches(table.ascending(), std::array{1, 2, 6, 7, 15}));
+    static_assert(matches(table.descending(), std::array{15, 7, 6, 2, 1}));
+    static_assert(matches(table.side_cross(), std::array{1, 15, 2, 7, 6}));
+    static_assert(matches(table.reverse(), std::array{2, 1, 6, 15, 7}));
+    static_assert(matches(table.order(), std::array{7, 15, 6, 1, 2}));
+    static_assert(matches(table.middle_out(), std::array{6, 15, 1, 7, 2}));
+    static_assert(*(table.begin_ascending_order() + 4) == 15);
+    static_assert(table.end_side_cross_order() - table.begin_side_cross_order() == 5);
+
+    SUBCASE("add and remove keep the sorted permutation") {
+        static_assert(matches(demo_table.ascending(), std::array{1, 1, 2, 6, 7}));
+        static_assert(matches(demo_table.order(), std::array{7, 6, 1, 2, 1}));
+        CHECK(demo_table.size() == 5);
+    }
+
+    SUBCASE("Runtime use matches MyContainer") {
+        ex4::MyStaticContainer<std::string, 4> names;
+        ex4::MyContainer<std::string> reference;
+        for (const char* name : {"delta", "alpha", "charlie", "bravo"}) {
+            names.add(name);
+            reference.add(name);
+        }
+        CHECK(std::ranges::equal(names.side_cross(), reference.side_cross()));
+        CHECK(std::ranges::equal(names.middle_out(), reference.middle_out()));
+
+        std::ostringstream printed, expected;
+        printed << names;
+        expected << reference;
+        CHECK(printed.str() == expected.str());
+
+        CHECK_THROWS_AS(names.add("echo"), std::length_error);
+        CHECK_THROWS_AS(names.remove("echo"), std::runtime_error);
+        CHECK_THROWS_AS(*names.end_order(), std::out_of_range);
+    }
+}
+
+TEST_CASE("Segmented Block Storage") {
+    using Segmented = ex4::SegmentedContainer<int, 8>;
+    static_assert(std::random_access_iterator<ex4::SegmentedStorage<int, 8>::const_iterator>);
+    static_assert(!ex4::detail::contiguous_storage<ex4::SegmentedStorage<int, 8>>);
+
+    SUBCASE("add never moves existing elements") {
+        Segmented container;
+        container.add(42);
+        const int* first = &*container.begin_order();
+        for (int i = 0; i < 1000; ++i) {
+            container.add(i);
+        }
+        CHECK(&*container.begin_order() == first);
+        CHECK(container.capacity() % 8 == 0);
+        CHECK(container.capacity() - container.size() < 8);
+    }
+
+    SUBCASE("add_range allocates only the blocks the range needs") {
+        Segmented container;
+        for (int i = 0; i < 8 * 100; ++i) {
+            container.add(i);
+        }
+        CHECK(container.capacity() == 8 * 100);
+        int one[] = {1};
+        container.add_range(std::begin(one), std::end(one));
+        CHECK(container.capacity() == 8 * 101);
+        int ten[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+        container.add_range(std::begin(ten), std::end(ten));
+        CHECK(container.capacity() == 8 * 102);
+    }
+
+    SUBCASE("Indexing across many pages of the block table") {
+        ex4::SegmentedStorage<int, 1> storage;
+        for (int i = 0; i < 1000; ++i) {
+            storage.push_back(i);
+        }
+        CHECK(storage.block_count() == 1000);
+        CHECK(storage[0] == 0);
+        CHECK(storage[7] == 7);
+        CHECK(storage[8] == 8);
+        CHECK(storage[999] == 999);
+        CHECK(*(storage.begin() + 500) == 500);
+        CHECK(storage.end() - storage.begin() == 1000);
+        CHECK(std::ranges::equal(storage, std::views::iota(0, 1000)));
+
+        storage.resize(10);
+        storage.shrink_to_fit();
+        CHECK(storage.block_count() == 10);
+        storage.push_back(10);
+        CHECK(storage[10] == 10);
+    }
+
+    SUBCASE("All orders match vector storage") {
+        Segmented segmented;
+        ex4::MyContainer<int> reference;
+        for (int i = 0; i < 100; ++i) {
+            int value = (i * 37) % 23;
+            segmented.add(value);
+            reference.add(value);
+        }
+        segmented.remove(5);
+        reference.remove(5);
+        segmented.add(-1);
+        reference.add(-1);
+
+        CHECK(segmented.size() == reference.size());
+        CHECK(std::ranges::equal(segmented.ascending(), reference.ascending()));
+        CHECK(std::ranges::equal(segmented.descending(), reference.descending()));
+        CHECK(std::ranges::equal(segmented.side_cross(), reference.side_cross()));
+        CHECK(std::ranges::equal(segmented.reverse(), reference.reverse()));
+        CHECK(std::ranges::equal(segmented.order(), reference.order()));
+        CHECK(std::ranges::equal(segmented.middle_out(), reference.middle_out()));
+        CHECK(toVector(segmented, "reverse") == toVector(reference, "reverse"));
+    }
+
+    SUBCASE("Blocks come from the allocator and are released") {
+        CountingResource resource;
+        {
+            ex4::SegmentedContainer<std::string, 4, std::pmr::polymorphic_allocator<std::string>> names(&resource);
+            for (const char* name : {"delta", "alpha", "charlie", "bravo", "echo"}) {
+                names.add(name);
+            }
+            CHECK(names.capacity() == 8);
+            CHECK(*names.begin_ascending_order() == "alpha");
+            names.remove("echo");
+            names.shrink_to_fit();
+            CHECK(names.capacity() == 4);
+
+            ex4::SegmentedContainer<std::string, 4, std::pmr::polymorphic_allocator<std::string>> copy(names);
+            CHECK(*copy.begin_descending_order() == "delta");
+        }
+        CHECK(resource.bytes_in_use == 0);
+    }
+}
+
+TEST_CASE("Memory-Mapped Storage") {
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "ex4_mapped_storage_test.bin";
+    std::filesystem::remove(path);
+
+    SUBCASE("Elements persist across reopen") {
+        {
+            ex4::MappedContainer<int> container{ex4::MappedStorage<int>(path.string())};
+            for (int value : {7, 15, 6, 1, 2}) {
+                container.add(value);
+            }
+            container.add(15);
+            container.remove(15);
+            CHECK(toVector(container, "ascending") == std::vector<int>({1, 2, 6, 7}));
+        }
+
+        ex4::MappedContainer<int> reopened{ex4::MappedStorage<int>(path.string())};
+        CHECK(reopened.size() == 4);
+        CHECK(toVector(reopened, "order") == std::vector<int>({7, 6, 1, 2}));
+        CHECK(toVector(reopened, "side_cross") == std::vector<int>({1, 7, 2, 6}));
+        CHECK(toVector(reopened, "reverse") == std::vector<int>({2, 1, 6, 7}));
+        CHECK(*reopened.begin_middle_out_order() == 1);
+    }
+
+    SUBCASE("Tombstoned removals do not come back on reopen") {
+        {
+            ex4::MappedContainer<int> container{ex4::MappedStorage<int>(path.string())};
+            for (int i = 0; i < 10; ++i) {
+                container.add(i);
+            }
+            container.set_compaction_threshold(0.5);
+            container.remove(3);
+            CHECK(container.tombstone_count() == 1);
+        }
+        {
+            ex4::MappedContainer<int> reopened{ex4::MappedStorage<int>(path.string())};
+            CHECK(reopened.size() == 9);
+            CHECK(toVector(reopened, "order") == std::vector<int>({0, 1, 2, 4, 5, 6, 7, 8, 9}));
+
+            // Letting go of the file through move assignment compacts it too
+            reopened.set_compaction_threshold(0.5);
+            reopened.remove(0);
+            reopened = ex4::MappedContainer<int>{1, 2};
+        }
+        ex4::MappedContainer<int> again{ex4::MappedStorage<int>(path.string())};
+        CHECK(toVector(again, "order") == std::vector<int>({1, 2, 4, 5, 6, 7, 8, 9}));
+    }
+
+    SUBCASE("Growth past the first mapping") {
+        ex4::MappedStorage<double> storage(path.string());
+        for (int i = 0; i < 5000; ++i) {
+            storage.push_back(5000 - i);
+        }
+        storage.flush();
+        ex4::MappedContainer<double> container(std::move(storage));
+        CHECK(container.size() == 5000);
+        CHECK(*container.begin_ascending_order() == 1.0);
+        CHECK(*container.begin_descending_order() == 5000.0);
+
+        container.shrink_to_fit();
+        CHECK(container.capacity() == 5000);
+        CHECK(std::filesystem::file_size(path) == 64 + 5000 * sizeof(double));
+    }
+
+    SUBCASE("Anonymous mapping and copies stay out of the file") {
+        ex4::MappedContainer<int> anonymous{3, 1, 2};
+        CHECK(toVector(anonymous, "ascending") == std::vector<int>({1, 2, 3}));
+
+        ex4::MappedContainer<int> file_backed{ex4::MappedStorage<int>(path.string())};
+        file_backed.add(42);
+        ex4::MappedContainer<int> copy(file_backed);
+        copy.add(7);
+        CHECK(file_backed.size() == 1);
+        CHECK(toVector(copy, "descending") == std::vector<int>({42, 7}));
+    }
+
+    SUBCASE("Rejects files of another element type") {
+        {
+            ex4::MappedStorage<int> storage(path.string());
+            storage.push_back(1);
+        }
+        CHECK_THROWS_AS(ex4::MappedStorage<double>(path.string()), std::runtime_error);
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("String Arena Storage") {
+    using Arena = ex4::StringArenaContainer<>;
+    static_assert(std::is_same_v<std::iter_reference_t<Arena::AscendingIterator>, std::string_view>);
+    static_assert(std::ranges::random_access_range<decltype(std::declval<const Arena&>().ascending())>);
+    // Views are not references - legacy algorithms must not treat these iterators as forward
+    static_assert(std::is_same_v<std::iterator_traits<Arena::AscendingIterator>::iterator_category, std::input_iterator_tag>);
+    static_assert(std::is_same_v<std::iterator_traits<ex4::StringArenaStorage<>::const_iterator>::iterator_category, std::input_iterator_tag>);
+
+    SUBCASE("All orders match std::string storage") {
+        Arena arena;
+        ex4::MyContainer<std::string> reference;
+        const char* words[] = {"delta", "a fairly long string that does not fit in SSO", "alpha", "charlie", "bravo", "alpha"};
+        for (const char* word : words) {
+            arena.add(word);
+            reference.add(word);
+        }
+        arena.add(std::string("echo"));
+        reference.add(std::string("echo"));
+
+        CHECK(std::ranges::equal(arena.ascending(), reference.ascending()));
+        CHECK(std::ranges::equal(arena.descending(), reference.descending()));
+        CHECK(std::ranges::equal(arena.side_cross(), reference.side_cross()));
+        CHECK(std::ranges::equal(arena.reverse(), reference.reverse()));
+        CHECK(std::ranges::equal(arena.order(), reference.order()));
+        CHECK(std::ranges::equal(arena.middle_out(), reference.middle_out()));
+
+        std::ostringstream printed, expected;
+        printed << arena;
+        expected << reference;
+        CHECK(printed.str() == expected.str());
+    }
+
+    SUBCASE("string_view adds copy characters only into the arena") {
+        CountingResource resource;
+        ex4::StringArenaContainer<std::pmr::polymorphic_allocator<std::string>> arena(&resource);
+        arena.reserve(64);
+        std::string_view long_word = "a string long enough to need a heap block of its own";
+        arena.add(long_word);
+        arena.add(long_word.substr(2, 6));
+        size_t after_first = resource.allocations;
+        for (int i = 0; i < 20; ++i) {
+            arena.add(long_word);
+        }
+        // The arena grows geometrically - far fewer allocations than strings
+        CHECK(resource.allocations - after_first < 10);
+        CHECK(*arena.begin_ascending_order() == long_word);
+        CHECK(*arena.begin_descending_order() == "string");
+    }
+
+    SUBCASE("Re-adding an element's own view") {
+        ex4::StringArenaStorage<> storage;
+        storage.push_back("abcdefgh");
+        size_t capacity = 0;
+        int reallocations = 0;
+        for (int i = 0; i < 100; ++i) {
+            storage.push_back(storage[storage.size() - 1]);
+            if (storage.memory_bytes() != capacity) {
+                capacity = storage.memory_bytes();
+                ++reallocations;
+            }
+        }
+        CHECK(reallocations > 3);
+        CHECK(reallocations < 20);  // Most re-adds copy within the current buffer
+        CHECK(storage.size() == 101);
+        CHECK(std::ranges::all_of(storage, [](std::string_view word) { return word == "abcdefgh"; }));
+    }
+
+    SUBCASE("A failed add leaves the arena unchanged") {
+        CountingResource resource;
+        ex4::StringArenaStorage<std::pmr::polymorphic_allocator<std::string>> storage(&resource);
+        storage.push_back("abc");
+        resource.allocation_limit = resource.allocations + 1;  // The arena may grow, the handles may not
+        CHECK_THROWS_AS(storage.push_back("defg"), std::bad_alloc);
+        CHECK(storage.size() == 1);
+        CHECK(storage.arena_bytes() == 3);
+        CHECK(storage[0] == "abc");
+        resource.allocation_limit = std::numeric_limits<size_t>::max();
+        storage.push_back("defg");
+        CHECK(storage[1] == "defg");
+    }
+
+    SUBCASE("remove compares stored views with the value") {
+        Arena arena{"kiwi", "banana", "apple", "banana"};
+        arena.remove("banana");
+        CHECK(std::ranges::equal(arena.order(), std::vector<std::string>({"kiwi", "apple"})));
+        CHECK_THROWS_AS(arena.remove("banana"), std::runtime_error);
+        arena.remove("kiwi");
+        CHECK(std::ranges::equal(arena.ascending(), std::vector<std::string>({"apple"})));
+    }
+}
+
+TEST_CASE("Count-Compressed Container") {
+    static_assert(std::ranges::forward_range<decltype(std::declval<const ex4::MyCountedContainer<int>&>().side_cross())>);
+
+    SUBCASE("Orders match MyContainer on the demo data") {
+        ex4::MyCountedContainer<int> counted{7, 15, 6, 1, 2, 15, 1};
+        ex4::MyContainer<int> reference{7, 15, 6, 1, 2, 15, 1};
+        CHECK(counted.size() == 7);
+        CHECK(counted.distinct_size() == 5);
+        CHECK(std::ranges::equal(counted.ascending(), reference.ascending()));
+        CHECK(std::ranges::equal(counted.descending(), reference.descending()));
+        CHECK(std::ranges::equal(counted.side_cross(), reference.side_cross()));
+
+        std::ostringstream printed;
+        printed << counted;
+        CHECK(printed.str() == "[1, 1, 2, 6, 7, 15, 15]");
+    }
+
+    SUBCASE("Memory scales with distinct values") {
+        ex4::MyCountedContainer<int> counted;
+        ex4::MyContainer<int> reference;
+        for (int i = 0; i < 100000; ++i) {
+            counted.add(i % 37);
+            reference.add(i % 37);
+        }
+        counted.add(5, 1000);
+        std::vector<int> fives(1000, 5);
+        reference.add_range(fives.begin(), fives.end());
+        CHECK(counted.size() == 101000);
+        CHECK(counted.distinct_size() == 37);
+        CHECK(counted.count(5) == 100000 / 37 + 1 + 1000);
+        CHECK(std::ranges::equal(counted.side_cross(), reference.side_cross()));
+    }
+
+    SUBCASE("remove drops the whole run") {
+        ex4::MyCountedContainer<std::string> names{"bob", "amy", "bob", "cat"};
+        names.remove("bob");
+        CHECK(names.size() == 2);
+        CHECK(names.count("bob") == 0);
+        CHECK(std::ranges::equal(names.descending(), std::vector<std::string>({"cat", "amy"})));
+        CHECK_THROWS_AS(names.remove("bob"), std::runtime_error);
+        CHECK_THROWS_AS(*names.end_ascending_order(), std::out_of_range);
+        CHECK_THROWS_AS(*names.end_side_cross_order(), std::out_of_range);
+    }
+}
+
+TEST_CASE("Memory Accounting") {
+    SUBCASE("Storage and index are reported separately") {
+        ex4::MyContainer<int> container;
+        container.reserve(100);
+        for (int i = 0; i < 100; ++i) {
+            container.add(100 - i);
+        }
+        ex4::MemoryUsage before = container.memory_usage();
+        CHECK(before.storage_bytes == 100 * sizeof(int));
+        CHECK(before.index_bytes == 0);
+
+        CHECK(*container.begin_ascending_order() == 1);
+        ex4::MemoryUsage after = container.memory_usage();
+        CHECK(after.storage_bytes == before.storage_bytes);
+        CHECK(after.index_bytes >= 100 * sizeof(size_t));
+        CHECK(after.peak_bytes == after.total_bytes());
+
+        // Iterators are handles - creating many of them costs nothing
+        std::vector<ex4::MyContainer<int>::DescendingIterator> iterators(50, container.begin_descending_order());
+        CHECK(container.memory_usage().total_bytes() == after.total_bytes());
+
+        container.release_caches();
+        ex4::MemoryUsage released = container.memory_usage();
+        CHECK(released.index_bytes == 0);
+        CHECK(released.peak_bytes == after.peak_bytes);
+    }
+
+    SUBCASE("A memory limit sheds the index instead of keeping it") {
+        ex4::MyContainer<int> container;
+        container.reserve(1000);
+        for (int i = 0; i < 1000; ++i) {
+            container.add((i * 7) % 1000);
+        }
+        container.set_memory_limit(1000 * sizeof(int) + 1000);
+        CHECK(*container.begin_side_cross_order() == 0);  // Traversal still builds the index it needs
+        CHECK(container.memory_usage().index_bytes > 0);
+
+        container.add(-1);
+        CHECK(container.memory_usage().index_bytes == 0);
+        CHECK(*container.begin_ascending_order() == -1);
+
+        container.set_memory_limit(0);
+        container.add(-2);
+        CHECK(container.memory_usage().index_bytes > 0);
+        CHECK(container.get_memory_limit() == 0);
+    }
+
+    SUBCASE("Copies and moves keep the memory limit") {
+        ex4::MyContainer<int> source{3, 1, 2};
+        source.set_memory_limit(4096);
+        CHECK(*source.begin_ascending_order() == 1);
+        size_t peak = source.memory_usage().peak_bytes;
+
+        ex4::MyContainer<int> copied(source);
+        ex4::MyContainer<int> copy_assigned;
+        copy_assigned = source;
+        CHECK(copied.get_memory_limit() == 4096);
+        CHECK(copy_assigned.get_memory_limit() == 4096);
+
+        ex4::MyContainer<int> moved(std::move(copied));
+        ex4::MyContainer<int> move_assigned;
+        source.release_caches();  // The peak now lies in the past and has to be carried over
+        move_assigned = std::move(source);
+        CHECK(moved.get_memory_limit() == 4096);
+        CHECK(move_assigned.get_memory_limit() == 4096);
+        CHECK(move_assigned.memory_usage().peak_bytes == peak);
+    }
+
+    SUBCASE("Storages report their own footprint") {
+        ex4::SmallContainer<int, 8> small{1, 2, 3};
+        CHECK(small.memory_usage().storage_bytes == 0);
+
+        ex4::SegmentedContainer<int, 64> segmented;
+        segmented.add(1);
+        CHECK(segmented.memory_usage().storage_bytes >= 64 * sizeof(int));
+
+        ex4::StringArenaContainer<> arena;
+        arena.add(std::string_view("abcdefgh"));
+        CHECK(arena.memory_usage().storage_bytes >= 8 + 8);
+    }
+}
+
+TEST_CASE("Bit-Packed Integer Storage") {
+    static_assert(std::random_access_iterator<ex4::PackedContainer<int>::OrderIterator>);
+    static_assert(std::is_same_v<std::iterator_traits<ex4::PackedContainer<int>::OrderIterator>::iterator_category, std::input_iterator_tag>);
+    static_assert(std::is_same_v<std::iterator_traits<ex4::PackedStorage<int>::const_iterator>::iterator_category, std::input_iterator_tag>);
+    static_assert(std::is_same_v<std::iterator_traits<ex4::SegmentedStorage<int, 8>::const_iterator>::iterator_category, std::random_access_iterator_tag>);
+
+    SUBCASE("All orders match vector storage") {
+        ex4::PackedContainer<int> packed;
+        ex4::MyContainer<int> reference;
+        for (int i = 0; i < 1000; ++i) {
+            int value = 3000 + (i * 2654435761u) % 4096;  // 12-bit spread above a common base
+            packed.add(value);
+            reference.add(value);
+        }
+        int some_value = *reference.begin_middle_out_order();
+        packed.remove(some_value);
+        reference.remove(some_value);
+        packed.add(-5);
+        reference.add(-5);
+
+        CHECK(packed.size() == reference.size());
+        CHECK(toVector(packed, "order") == toVector(reference, "order"));
+        CHECK(toVector(packed, "reverse") == toVector(reference, "reverse"));
+        CHECK(toVector(packed, "ascending") == toVector(reference, "ascending"));
+        CHECK(toVector(packed, "descending") == toVector(reference, "descending"));
+        CHECK(toVector(packed, "side_cross") == toVector(reference, "side_cross"));
+        CHECK(toVector(packed, "middle_out") == toVector(reference, "middle_out"));
+        CHECK(packed.begin_order()[500] == reference.begin_order()[500]);
+
+        // Appends merge into the sorted index, tombstones make scans skip dead elements
+        for (int value : {9000, 3001, -7}) {
+            packed.add(value);
+            reference.add(value);
+        }
+        CHECK(toVector(packed, "ascending") == toVector(reference, "ascending"));
+        packed.set_compaction_threshold(0.5);
+        reference.set_compaction_threshold(0.5);
+        packed.remove(9000);
+        reference.remove(9000);
+        CHECK(toVector(packed, "order") == toVector(reference, "order"));
+        CHECK(toVector(packed, "reverse") == toVector(reference, "reverse"));
+        CHECK(toVector(packed, "ascending") == toVector(reference, "ascending"));
+    }
+
+    SUBCASE("Narrow values take a fraction of the memory") {
+        ex4::PackedContainer<int> packed;
+        for (int i = 0; i < 128 * 100; ++i) {
+            packed.add(i % 4000);
+        }
+        packed.shrink_to_fit();
+        CHECK(packed.memory_usage().storage_bytes * 2 < packed.size() * sizeof(int));
+        CHECK(*packed.begin_descending_order() == 3999);
+    }
+
+    SUBCASE("Full-width and constant blocks") {
+        ex4::PackedStorage<std::int64_t> storage;
+        for (int i = 0; i < 128; ++i) {
+            storage.push_back(i % 2 ? std::numeric_limits<std::int64_t>::max() : std::numeric_limits<std::int64_t>::min());
+        }
+        for (int i = 0; i < 128; ++i) {
+            storage.push_back(42);
+        }
+        CHECK(storage.size() == 256);
+        CHECK(storage[0] == std::numeric_limits<std::int64_t>::min());
+        CHECK(storage[127] == std::numeric_limits<std::int64_t>::max());
+        CHECK(storage[200] == 42);
+        CHECK(std::count(storage.begin(), storage.end(), 42) == 128);
+
+        // Scans decode whole blocks, reads extract single values - both must agree
+        std::vector<std::int64_t> expected(storage.begin(), storage.end());
+        ex4::PackedContainer<std::int64_t> container(std::move(storage));
+        CHECK(std::ranges::equal(container.order(), expected));
+        CHECK(std::ranges::equal(container.reverse(), expected | std::views::reverse));
+
+        ex4::PackedContainer<std::int16_t> narrow;
+        std::vector<std::int16_t> narrow_expected;
+        for (int i = 0; i < 300; ++i) {
+            narrow.add(static_cast<std::int16_t>(i * 211 - 32000));
+            narrow_expected.push_back(static_cast<std::int16_t>(i * 211 - 32000));
+        }
+        CHECK(std::ranges::equal(narrow.order(), narrow_expected));
+        CHECK(narrow.begin_order()[255] == narrow_expected[255]);
+    }
+
+    SUBCASE("Threads can read one container at once") {
+        ex4::PackedContainer<int> container;
+        for (int i = 0; i < 128 * 40; ++i) {
+            container.add(i % 1000 * 3);
+        }
+        const ex4::PackedContainer<int>& shared = container;
+
+        // Each thread mixes single reads at its own stride with full scans
+        std::vector<int> mismatches(4, 0);
+        std::vector<std::thread> readers;
+        for (size_t t = 0; t < mismatches.size(); ++t) {
+            readers.emplace_back([&shared, &mismatches, t]() {
+                auto first = shared.begin_order();
+                for (int round = 0; round < 20; ++round) {
+                    for (size_t i = t; i < shared.size(); i += t + 2) {
+                        mismatches[t] += first[i] != static_cast<int>(i % 1000 * 3);
+                    }
+                    size_t i = 0;
+                    for (int value : shared.order()) {
+                        mismatches[t] += value != static_cast<int>(i++ % 1000 * 3);
+                    }
+                }
+            });
+        }
+        for (std::thread& reader : readers) {
+            reader.join();
+        }
+        CHECK(mismatches == std::vector<int>(4, 0));
+    }
+}
+
+struct EqualityCounted {
+    static long equality_checks;
+    int value;
+
+    EqualityCounted(int v) : value(v) {}
+    bool operator<(const EqualityCounted& other) const { return value < other.value; }
+    bool operator==(const EqualityCounted& other) const { ++equality_checks; return value == other.value; }
+};
+long EqualityCounted::equality_checks = 0;
+
+struct EqualityCountedHash {
+    size_t operator()(const EqualityCounted& item) const { return std::hash<int>()(item.value); }
+};
+
+TEST_CASE("Hash Value Index") {
+    using Indexed = ex4::MyContainer<EqualityCounted, std::allocator<EqualityCounted>, std::vector<EqualityCounted>,
+                                     ex4::HashValueIndex<EqualityCounted, EqualityCountedHash>>;
+
+    SUBCASE("A miss is detected without scanning") {
+        Indexed container;
+        for (int i = 0; i < 10000; ++i) {
+            container.add(EqualityCounted(i % 1000));
+        }
+        EqualityCounted::equality_checks = 0;
+        CHECK_THROWS_AS(container.remove(EqualityCounted(5000)), std::runtime_error);
+        CHECK(EqualityCounted::equality_checks < 10);
+        CHECK(container.size() == 10000);
+    }
+
+    SUBCASE("A hit stops comparing after the last occurrence") {
+        Indexed container;
+        container.add(EqualityCounted(-1));
+        for (int i = 0; i < 10000; ++i) {
+            container.emplace(i);
+        }
+        EqualityCounted::equality_checks = 0;
+        container.remove(EqualityCounted(-1));
+        CHECK(EqualityCounted::equality_checks < 10);
+        CHECK(container.size() == 10000);
+        CHECK(container.begin_order()->value == 0);
+        CHECK((container.end_order() - 1)->value == 9999);
+    }
+
+    SUBCASE("Index follows every kind of modification") {
+        using IntIndexed = ex4::MyContainer<int, std::allocator<int>, std::vector<int>, ex4::HashValueIndex<int>>;
+        IntIndexed container{7, 15, 6, 1, 2, 15, 1};
+        int more[] = {15, 3};
+        container.add_range(std::begin(more), std::end(more));
+        container.remove(15);
+        CHECK_THROWS_AS(container.remove(15), std::runtime_error);
+        CHECK(toVector(container, "order") == std::vector<int>({7, 6, 1, 2, 1, 3}));
+
+        IntIndexed copy(container);
+        copy.remove(1);
+        CHECK_THROWS_AS(copy.remove(1), std::runtime_error);
+        container.remove(1);
+
+        IntIndexed moved(std::move(container));
+        CHECK_THROWS_AS(container.remove(7), std::runtime_error);
+        moved.remove(7);
+        CHECK(toVector(moved, "ascending") == std::vector<int>({2, 3, 6}));
+        CHECK(moved.memory_usage().index_bytes > 0);
+    }
+
+    SUBCASE("Adding a stored element indexes the copy") {
+        using StringIndexed = ex4::MyContainer<std::string, std::allocator<std::string>, std::vector<std::string>,
+                                               ex4::HashValueIndex<std::string>>;
+        StringIndexed container;
+        container.add(std::string(40, 'x'));  // Too long for the small string buffer - lives on the heap
+        for (int i = 0; i < 20; ++i) {
+            container.add(*container.begin_order());  // Reallocates on every power of two
+        }
+        CHECK(std::ranges::equal(container.order(), std::vector<std::string>(21, std::string(40, 'x'))));
+        container.remove(std::string(40, 'x'));  // Removes all occurrences
+        CHECK(container.size() == 0);
+        CHECK_THROWS_AS(container.remove(std::string(40, 'x')), std::runtime_error);
+    }
+
+    SUBCASE("The table allocates through the container's allocator") {
+        using Allocator = std::pmr::polymorphic_allocator<int>;
+        CountingResource resource;
+        {
+            ex4::MyContainer<int, Allocator, std::vector<int, Allocator>, ex4::HashValueIndex<int>> container(&resource);
+            container.reserve(1000);
+            size_t global_before = global_allocations;
+            for (int i = 0; i < 1000; ++i) {
+                container.add(i);
+            }
+            CHECK(global_allocations == global_before);
+            CHECK(resource.bytes_in_use > 1000 * sizeof(int));
+            container.remove(500);
+            CHECK_THROWS_AS(container.remove(500), std::runtime_error);
+        }
+        CHECK(resource.bytes_in_use == 0);
+    }
+
+    SUBCASE("String views are looked up without building strings") {
+        using Allocator = std::pmr::polymorphic_allocator<std::string>;
+        CountingResource resource;
+        ex4::MyContainer<std::string, Allocator, ex4::StringArenaStorage<Allocator>, ex4::HashValueIndex<std::string>> names(&resource);
+        std::string name(40, 'n');  // Too long for the small string buffer
+        names.add(name);
+
+        size_t global_before = global_allocations;
+        for (int i = 0; i < 100; ++i) {
+            names.add(name);
+        }
+        CHECK(global_allocations == global_before);
+        CHECK(names.size() == 101);
+        names.remove(name);
+        CHECK(names.size() == 0);
+    }
+
+    SUBCASE("Default policy keeps no index") {
+        static_assert(!ex4::NoValueIndex::enabled);
+        static_assert(std::is_empty_v<ex4::NoValueIndex>);  // [[no_unique_address]] - costs no space
+    }
+}
+
+TEST_CASE("Batch Removal") {
+    SUBCASE("Matches a sequence of single removes") {
+        MyContainer<int> batch;
+        MyContainer<int> single;
+        for (int i = 0; i < 5000; ++i) {
+            batch.add((i * 37) % 1000);
+            single.add((i * 37) % 1000);
+        }
+        CHECK(*batch.begin_ascending_order() == 0);
+
+        std::vector<int> victims;
+        for (int v = 0; v < 1000; v += 3) {
+            victims.push_back(v);
+        }
+        for (int v : victims) {
+            single.remove(v);
+        }
+        CHECK(batch.remove_all(victims) == 5000 - single.size());
+        CHECK(toVector(batch, "order") == toVector(single, "order"));
+        CHECK(toVector(batch, "ascending") == toVector(single, "ascending"));
+    }
+
+    SUBCASE("Missing and repeated values are skipped") {
+        MyContainer<int> container{7, 15, 6, 1, 2, 15, 1};
+        auto ascending = container.begin_ascending_order();
+        CHECK(container.remove_all({42, 43}) == 0);
+        CHECK(*ascending == 1);  // Nothing removed - iterators stay valid
+
+        CHECK(container.remove_all({15, 15, 42, 1}) == 4);
+        CHECK(toVector(container, "order") == std::vector<int>({7, 6, 2}));
+    }
+
+    SUBCASE("Sorted probe for types without std::hash") {
+        MyContainer<CompareCounted> container;
+        for (int i = 0; i < 100; ++i) {
+            container.emplace(i % 10);
+        }
+        std::vector<CompareCounted> victims{CompareCounted(3), CompareCounted(7)};
+        CHECK(container.remove_all(victims) == 20);
+        CHECK(container.size() == 80);
+        CHECK(container.begin_descending_order()->value == 9);
+    }
+
+    SUBCASE("Works with view storages and the value index") {
+        ex4::StringArenaContainer<> names{"kiwi", "apple", "fig", "apple", "pear"};
+        CHECK(names.remove_all(std::vector<std::string>{"apple", "pear", "plum"}) == 3);
+        CHECK(std::ranges::equal(names.order(), std::vector<std::string>({"kiwi", "fig"})));
+
+        ex4::MyContainer<int, std::allocator<int>, std::vector<int>, ex4::HashValueIndex<int>> indexed{1, 2, 3, 2, 1};
+        CHECK(indexed.remove_all(std::views::iota(2, 10)) == 3);
+        CHECK_THROWS_AS(indexed.remove(2), std::runtime_error);
+        CHECK(toVector(indexed, "order") == std::vector<int>({1, 1}));
+    }
+}
+
+TEST_CASE("Non-Throwing Removal") {
+    SUBCASE("try_remove reports counts") {
+        MyContainer<int> container{7, 15, 6, 1, 2, 15, 1};
+        auto order = container.begin_order();
+        CHECK(container.try_remove(42) == 0);
+        CHECK(*order == 7);  // A miss leaves iterators valid
+        CHECK(container.try_remove(15) == 2);
+        CHECK(container.try_remove(15) == 0);
+        CHECK(toVector(container, "order") == std::vector<int>({7, 6, 1, 2, 1}));
+    }
+
+    SUBCASE("try_remove is a single pass") {
+        MyContainer<EqualityCounted> container;
+        for (int i = 0; i < 1000; ++i) {
+            container.emplace(i % 10);
+        }
+        EqualityCounted::equality_checks = 0;
+        CHECK(container.try_remove(EqualityCounted(3)) == 100);
+        CHECK(EqualityCounted::equality_checks == 1000);
+
+        EqualityCounted::equality_checks = 0;
+        CHECK(container.try_remove(EqualityCounted(42)) == 0);
+        CHECK(EqualityCounted::equality_checks == 900);
+    }
+
+    SUBCASE("remove_if visits elements once, in order") {
+        MyContainer<int> container{7, 15, 6, 1, 2, 15, 1};
+        std::vector<int> visited;
+        size_t removed = container.remove_if([&visited](int value) {
+            visited.push_back(value);
+            return value > 5;
+        });
+        CHECK(removed == 4);
+        CHECK(visited == std::vector<int>({7, 15, 6, 1, 2, 15, 1}));
+        CHECK(toVector(container, "ascending") == std::vector<int>({1, 1, 2}));
+        CHECK(container.remove_if([](int) { return false; }) == 0);
+    }
+
+    SUBCASE("erase_first removes one occurrence") {
+        MyContainer<int> container{1, 5, 1, 5};
+        CHECK(container.erase_first(5));
+        CHECK(toVector(container, "order") == std::vector<int>({1, 1, 5}));
+        CHECK(container.erase_first(5));
+        CHECK_FALSE(container.erase_first(5));
+
+        ex4::StringArenaContainer<> names{"ann", "bob", "ann"};
+        CHECK(names.erase_first("ann"));
+        CHECK(std::ranges::equal(names.order(), std::vector<std::string>({"bob", "ann"})));
+    }
+
+    SUBCASE("Misses leave tombstones and iterators alone") {
+        MyContainer<int> container{7, 15, 6, 1, 2, 15, 1, 3, 9, 4};
+        container.set_compaction_threshold(0.5);
+        container.remove(15);
+        container.remove(1);
+        CHECK(container.tombstone_count() == 4);  // 4 of 10 dead is not above 50%
+
+        auto order = container.begin_order() + 1;
+        auto ascending = container.begin_ascending_order() + 1;
+        CHECK(container.try_remove(42) == 0);
+        CHECK(container.remove_if([](int value) { return value > 100; }) == 0);
+        CHECK_FALSE(container.erase_first(42));
+        CHECK(container.remove_all({42, 43}) == 0);
+
+        CHECK(container.tombstone_count() == 4);
+        CHECK(*order == 6);
+        CHECK(*ascending == 3);
+        CHECK(toVector(container, "order") == std::vector<int>({7, 6, 2, 3, 9, 4}));
+    }
+
+    SUBCASE("Value index stays in step") {
+        ex4::MyContainer<int, std::allocator<int>, std::vector<int>, ex4::HashValueIndex<int>> indexed{4, 4, 8, 9};
+        CHECK(indexed.erase_first(4));
+        CHECK(indexed.remove_if([](int value) { return value > 8; }) == 1);
+        CHECK(indexed.try_remove(9) == 0);
+        CHECK(indexed.try_remove(4) == 1);
+        CHECK_THROWS_AS(indexed.remove(4), std::runtime_error);
+        CHECK(toVector(indexed, "order") == std::vector<int>({8}));
+    }
+}
+
+TEST_CASE("Tombstone Deletion") {
+    const std::vector<std::string> orders = {"ascending", "descending", "side_cross", "reverse", "order", "middle_out"};
+
+    SUBCASE("Every order skips dead elements") {
+        MyContainer<int> deferred;
+        MyContainer<int> immediate;
+        deferred.set_compaction_threshold(0.9);
+        for (int i = 0; i < 300; ++i) {
+            deferred.add((i * 37) % 101);
+            immediate.add((i * 37) % 101);
+        }
+        for (int value : {5, 17, 42, 99, 0}) {
+            CHECK(deferred.try_remove(value) == immediate.try_remove(value));
+        }
+        CHECK(deferred.remove_if([](int value) { return value % 7 == 3; }) == immediate.remove_if([](int value) { return value % 7 == 3; }));
+        CHECK(deferred.erase_first(8) == immediate.erase_first(8));
+        CHECK(deferred.remove_all({1, 2, 3}) == immediate.remove_all({1, 2, 3}));
+
+        CHECK(deferred.tombstone_count() > 0);
+        CHECK(deferred.size() == immediate.size());
+        CHECK(deferred.capacity() >= 300);
+        for (const std::string& order : orders) {
+            CHECK(toVector(deferred, order) == toVector(immediate, order));
+        }
+
+        // Appends after removals are merged into the sorted order as usual
+        deferred.add(5);
+        immediate.add(5);
+        CHECK(toVector(deferred, "ascending") == toVector(immediate, "ascending"));
+        CHECK(toVector(deferred, "order") == toVector(immediate, "order"));
+
+        std::ostringstream deferred_text, immediate_text;
+        deferred_text << deferred;
+        immediate_text << immediate;
+        CHECK(deferred_text.str() == immediate_text.str());
+    }
+
+    SUBCASE("Threads can share a container with tombstones") {
+        MyContainer<int> container;
+        container.set_compaction_threshold(0.9);
+        for (int i = 0; i < 10000; ++i) {
+            container.add(i);
+        }
+        container.remove_if([](int value) { return value % 3 == 0; });
+        const MyContainer<int>& shared = container;
+
+        std::vector<long long> sums(2, 0);
+        std::vector<std::thread> readers;
+        for (size_t t = 0; t < sums.size(); ++t) {
+            readers.emplace_back([&shared, &sums, t]() {
+                for (int value : shared.order()) {
+                    sums[t] += value;
+                }
+            });
+        }
+        for (std::thread& reader : readers) {
+            reader.join();
+        }
+        long long expected = 0;
+        for (int i = 0; i < 10000; ++i) {
+            expected += (i % 3 == 0) ? 0 : i;
+        }
+        CHECK(sums[0] == expected);
+        CHECK(sums[1] == expected);
+    }
+
+    SUBCASE("Compaction runs once the threshold is crossed") {
+        MyContainer<int> container;
+        container.set_compaction_threshold(0.25);
+        for (int i = 0; i < 8; ++i) {
+            container.add(i);
+        }
+        container.remove(0);
+        container.remove(1);
+        CHECK(container.tombstone_count() == 2);  // 2 of 8 is not above 25%
+        container.remove(2);
+        CHECK(container.tombstone_count() == 0);
+        CHECK(toVector(container, "order") == std::vector<int>({3, 4, 5, 6, 7}));
+
+        container.remove(7);
+        CHECK(container.tombstone_count() == 1);
+        container.compact();
+        CHECK(container.tombstone_count() == 0);
+        CHECK(toVector(container, "reverse") == std::vector<int>({6, 5, 4, 3}));
+
+        container.remove(6);
+        container.set_compaction_threshold(0);
+        CHECK(container.tombstone_count() == 0);
+        CHECK(container.size() == 3);
+        CHECK_THROWS_AS(container.set_compaction_threshold(1.0), std::invalid_argument);
+    }
+
+    SUBCASE("Lowering the threshold compacts, a later miss changes nothing") {
+        MyContainer<int> container;
+        for (int i = 0; i < 10; ++i) {
+            container.add(i);
+        }
+        container.set_compaction_threshold(0.5);
+        for (int i = 0; i < 4; ++i) {
+            container.remove(i);
+        }
+        CHECK(container.tombstone_count() == 4);
+        container.set_compaction_threshold(0.25);  // 4 of 10 is already above 25%
+        CHECK(container.tombstone_count() == 0);
+        CHECK(container.size() == 6);
+
+        CHECK(toVector(container, "ascending") == std::vector<int>({4, 5, 6, 7, 8, 9}));
+        CHECK(container.try_remove(99) == 0);
+        CHECK(toVector(container, "ascending") == std::vector<int>({4, 5, 6, 7, 8, 9}));
+        CHECK(toVector(container, "descending") == std::vector<int>({9, 8, 7, 6, 5, 4}));
+    }
+
+    SUBCASE("Removing everything leaves an empty container") {
+        MyContainer<int> container{4, 4, 4, 5};
+        container.set_compaction_threshold(0.99);
+        container.remove(4);
+        CHECK(container.tombstone_count() == 3);
+        CHECK(toVector(container, "side_cross") == std::vector<int>({5}));
+        container.remove(5);  // All dead is always past the threshold
+        CHECK(container.empty());
+        CHECK(container.tombstone_count() == 0);
+        CHECK(container.begin_ascending_order() == container.end_ascending_order());
+        CHECK(container.begin_order() == container.end_order());
+        CHECK_THROWS_AS(container.remove(4), std::runtime_error);
+        container.add(9);
+        CHECK(toVector(container, "middle_out") == std::vector<int>({9}));
+    }
+
+    SUBCASE("Copies, value index and other storages") {
+        ex4::MyContainer<int, std::allocator<int>, std::vector<int>, ex4::HashValueIndex<int>> indexed{1, 2, 3, 2, 1};
+        indexed.set_compaction_threshold(0.9);
+        CHECK(indexed.try_remove(2) == 2);
+        CHECK(indexed.try_remove(2) == 0);
+        auto copy = indexed;
+        CHECK(copy.tombstone_count() == 2);
+        CHECK(toVector(copy, "descending") == std::vector<int>({3, 1, 1}));
+
+        ex4::SegmentedContainer<int, 4> segmented{9, 8, 7, 6, 5, 4};
+        segmented.set_compaction_threshold(0.5);
+        segmented.remove(8);
+        segmented.remove(5);
+        CHECK(toVector(segmented, "side_cross") == std::vector<int>({4, 9, 6, 7}));
+
+        ex4::StringArenaContainer<> names{"ann", "bob", "cid", "dan"};
+        names.set_compaction_threshold(0.9);
+        names.remove("bob");
+        CHECK(std::ranges::equal(names.order(), std::vector<std::string>({"ann", "cid", "dan"})));
+        CHECK(std::ranges::equal(names.descending(), std::vector<std::string>({"dan", "cid", "ann"})));
+        names.shrink_to_fit();
+        CHECK(names.tombstone_count() == 0);
+        CHECK(names.size() == 3);
+    }
 }
\ No newline at end of file